@@ -0,0 +1,1100 @@
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include "FlatOut2DB.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool tMappedFile::Open(const char* fileName) {
+	Close();
+#ifdef _WIN32
+	hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+
+	hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!hMapping) {
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		Close();
+		return false;
+	}
+	size = fileSize.QuadPart;
+#else
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	auto mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file referenced
+	if (mapping == MAP_FAILED) return false;
+
+	data = (const char*)mapping;
+	size = st.st_size;
+#endif
+	return true;
+}
+
+void tMappedFile::Close() {
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (hMapping) CloseHandle(hMapping);
+	if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+	hMapping = nullptr;
+	hFile = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap((void*)data, size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+// same text as the default ostream formatting, without going through the locale for every scalar
+template<typename T>
+void AppendNumber(std::string& out, T value) {
+	char buf[32];
+	std::to_chars_result result;
+	if constexpr (std::is_floating_point_v<T>) result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+	else result = std::to_chars(buf, buf + sizeof(buf), value);
+	out.append(buf, result.ptr);
+}
+
+void tDBValue::WriteValueToFile(const tDBFile& db, std::string& out, int index) const {
+	switch (valueType) {
+		case DBVALUE_CHAR: {
+			AppendNumber(out, (int)GetAsChar(index));
+		} break;
+		case DBVALUE_STRING: {
+			out += '"';
+			out += GetAsString(index);
+			out += '"';
+		} break;
+		case DBVALUE_BOOL: {
+			out += GetAsInt(index) != 0 ? "true" : "false";
+		} break;
+		case DBVALUE_INT: {
+			AppendNumber(out, GetAsInt(index));
+		} break;
+		case DBVALUE_FLOAT: {
+			auto value = GetAsFloat(index);
+			if (std::abs(value) < 0.00001) value = 0;
+			AppendNumber(out, value);
+		} break;
+		case DBVALUE_RGBA: {
+			out += "{ ";
+			for (int i = 0; i < 4; i++) {
+				AppendNumber(out, (int)GetAsChar((index * 4) + i));
+				if (i < 4 - 1) out += ", ";
+			}
+			out += " }";
+		} break;
+		case DBVALUE_VECTOR2:
+		case DBVALUE_VECTOR3:
+		case DBVALUE_VECTOR4: {
+			int valueCount = (valueType - DBVALUE_VECTOR2) + 2;
+			out += "{ ";
+			for (int i = 0; i < valueCount; i++) {
+				auto value = GetAsFloat((index * valueCount) + i);
+				if (std::abs(value) < 0.00001) value = 0;
+				AppendNumber(out, value);
+				if (i < valueCount - 1) out += ", ";
+			}
+			out += " }";
+		} break;
+		case DBVALUE_NODE: {
+			out += '"';
+			out += db.GetFullPathForDBNode(GetAsShort(index));
+			out += '"';
+		} break;
+		default: {
+			db.Warn("Unknown value type " + std::to_string(valueType) + " for " + GetName());
+			out += "*UNKNOWN*";
+		} break;
+	}
+}
+
+void tDBValue::WriteToFile(const tDBFile& db, std::string& out) const {
+	auto typeName = valueType < DBVALUE_MAX_COUNT ? aValueTypeNames[valueType] : nullptr;
+	out += typeName ? typeName : "*UNKNOWN*";
+	// const char* for variable strings
+	if (valueType == DBVALUE_STRING && arrayType == DBARRAY_VARIABLE) {
+		out += '*';
+	}
+	out += ' ';
+	for (auto name = GetName(); *name; name++) {
+		if (*name == '[') out += '(';
+		else if (*name == ']') out += ')';
+		else out += *name;
+	}
+	if (arrayType == DBARRAY_FIXED) {
+		// const char[i] for fixed strings
+		if (valueType == DBVALUE_STRING) {
+			out += '[';
+			AppendNumber(out, size);
+			out += ']';
+		}
+		else out += "[]";
+	}
+	out += " = ";
+
+	// one-liner if it's just one value, else one line per entry
+	if (arrayType == DBARRAY_FIXED && valueType != DBVALUE_STRING) {
+		out += "{\n";
+		if (size % GetValueTypeSize() != 0) {
+			db.Warn("Bad array size for " + (std::string)GetName() + " (" + std::to_string(size) + ", not divisible by " + std::to_string(GetValueTypeSize()) + ")");
+		}
+		for (int i = 0; i < size / GetValueTypeSize(); i++) {
+			out += '\t';
+			WriteValueToFile(db, out, i);
+			if (i < (size / GetValueTypeSize()) - 1) out += ",\n";
+		}
+		out += "\n}";
+	}
+	else {
+		if (valueType != DBVALUE_STRING && size != GetValueTypeSize()) {
+			db.Warn("Bad size for " + (std::string)GetName() + " (" + std::to_string(size) + ", expected " + std::to_string(GetValueTypeSize()) + ")");
+		}
+		WriteValueToFile(db, out, 0);
+	}
+	out += ";\n";
+}
+
+size_t tDBNode::GetId(const tDBFile& db) const {
+	return this - db.pRootNode;
+}
+
+bool tDBNode::DoesAnythingDependOnMe(const tDBFile& db) const {
+	return db.aNodeChildCounts[GetId(db)] > 0;
+}
+
+const tDBValue* tDBNode::GetValue(const tDBFile& db, int id) const {
+	if (id >= dataCount) return nullptr;
+	return db.aValues[db.aNodeFirstValues[GetId(db)] + id];
+}
+
+void tDBNode::WriteValuesToBuffer(const tDBFile& db, std::string& out) const {
+	for (int j = 0; j < dataCount; j++) {
+		GetValue(db, j)->WriteToFile(db, out);
+	}
+}
+
+const std::string& tDBNode::GetFullPath(const tDBFile& db) const {
+	return db.aNodePaths[GetId(db)];
+}
+
+const std::string& tDBFile::GetFullPathForDBNode(int id) const {
+	static const std::string invalidPath;
+	if (id >= nNumNodes) {
+		Warn("Invalid node reference " + std::to_string(id));
+		return invalidPath;
+	}
+	return pRootNode[id].GetFullPath(*this);
+}
+
+// values are stored back to back, so each one is only found by walking the ones before it
+void BuildValueTable(tDBFile& db) {
+	db.aValues.clear();
+	db.aNodeFirstValues.clear();
+	db.aNodeFirstValues.reserve(db.nNumNodes);
+	for (size_t i = 0; i < db.nNumNodes; i++) {
+		auto node = &db.pRootNode[i];
+		db.aNodeFirstValues.push_back(db.aValues.size());
+
+		auto value = (const char*)node + node->pValues;
+		for (int j = 0; j < node->dataCount; j++) {
+			db.aValues.push_back((const tDBValue*)value);
+			value += ((const tDBValue*)value)->size + 0xC; // size + data
+		}
+	}
+}
+
+// each path is its parent's path plus its own name, so every node is only built once
+void BuildNodePaths(tDBFile& db) {
+	enum { PATH_NONE, PATH_PENDING, PATH_DONE };
+	std::vector<uint8_t> states(db.nNumNodes, PATH_NONE);
+	std::vector<size_t> chain;
+	db.aNodePaths.clear();
+	db.aNodePaths.resize(db.nNumNodes);
+	for (size_t i = 0; i < db.nNumNodes; i++) {
+		// walk up until a node that already has a path, parents are usually written before their children
+		auto id = i;
+		while (states[id] == PATH_NONE) {
+			states[id] = PATH_PENDING;
+			chain.push_back(id);
+			auto parentId = db.pRootNode[id].GetParent()->GetId(db);
+			if (parentId == id || parentId >= db.nNumNodes) break;
+			id = parentId;
+		}
+
+		while (!chain.empty()) {
+			id = chain.back();
+			chain.pop_back();
+
+			auto node = &db.pRootNode[id];
+			auto parentId = node->GetParent()->GetId(db);
+			if (parentId == id || parentId >= db.nNumNodes || states[parentId] != PATH_DONE) {
+				db.aNodePaths[id] = node->GetName(); // root node, no parent
+			}
+			else {
+				db.aNodePaths[id] = db.aNodePaths[parentId] + "/" + node->GetName();
+			}
+			states[id] = PATH_DONE;
+		}
+	}
+}
+
+// tables every reader needs, all built up front so nothing changes while the db is being read
+void IndexDBData(tDBFile& db, const tDBNode* data, int count) {
+	db.pRootNode = data;
+	db.nNumNodes = count;
+
+	db.aNodeChildCounts.clear();
+	db.aNodeChildCounts.resize(count);
+	for (int i = 0; i < count; i++) {
+		auto parentId = data[i].GetParent()->GetId(db);
+		if (parentId < count) db.aNodeChildCounts[parentId]++;
+	}
+	BuildValueTable(db);
+	BuildNodePaths(db);
+}
+
+bool OpenDB(tDBFile& db, const char* data, size_t size) {
+	tDBHeader header;
+	if (size <= sizeof(header)) return false;
+	memcpy(&header, data, sizeof(header));
+
+	// PDB1
+	if (header.identifier != 0x1A424450 || header.version != 512 || header.numNodes == 0) return false;
+	if (size < sizeof(header) + (size_t)header.numNodes * sizeof(tDBNode)) return false;
+
+	db.pData = data;
+	db.nDataSize = size;
+	IndexDBData(db, (const tDBNode*)(data + sizeof(header)), header.numNodes);
+	return true;
+}
+
+// maps the file instead of reading it, everything stays valid for as long as the db stays open
+bool OpenDBFile(tDBFile& db, const std::string& fileName) {
+	db.fileName = fileName;
+	if (!db.file.Open(fileName.c_str())) return false;
+	return OpenDB(db, db.file.data, db.file.size);
+}
+
+// children are linked backwards from the last one, so this only visits the nodes in one folder
+const tDBNode* FindChildNode(const tDBFile& db, const tDBNode* node, std::string_view name) {
+	if (!node->lastChildOffset) return nullptr;
+
+	auto child = node + node->lastChildOffset;
+	while (child >= db.pRootNode && child < db.pRootNode + db.nNumNodes) {
+		if (child->GetName() == name) return child;
+		if (child->prevNodeOffset >= 0) break; // first node in the folder
+		child += child->prevNodeOffset;
+	}
+	return nullptr;
+}
+
+// follows a root/Path/To/Node path down from the root one name at a time
+const tDBNode* FindNodeByPath(const tDBFile& db, std::string_view path) {
+	auto node = db.pRootNode;
+	auto end = path.find('/');
+	if (path.substr(0, end) != node->GetName()) return nullptr;
+	while (end != std::string_view::npos && node) {
+		path.remove_prefix(end + 1);
+		end = path.find('/');
+		node = FindChildNode(db, node, path.substr(0, end));
+	}
+	return node;
+}
+
+const tDBValue* FindNodeValue(const tDBFile& db, const tDBNode* node, std::string_view name) {
+	for (int i = 0; i < node->dataCount; i++) {
+		auto value = node->GetValue(db, i);
+		if (value->GetName() == name) return value;
+	}
+	return nullptr;
+}
+
+// one pass over the nodes and their values, then one over the parent links that visits every node once
+size_t VerifyDBData(const char* data, size_t size, const std::function<void(const std::string&)>& onProblem) {
+	size_t numProblems = 0;
+	auto problem = [&](const std::string& str) {
+		numProblems++;
+		onProblem(str);
+	};
+
+	tDBHeader header;
+	if (size < sizeof(header)) {
+		problem("File is too small for a header");
+		return numProblems;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.identifier != 0x1A424450) problem("Not a PDB1 file");
+	else if (header.version != 512) problem("Unknown version " + std::to_string(header.version));
+	else if (header.numNodes == 0) problem("No nodes");
+	else if (size < sizeof(header) + (size_t)header.numNodes * sizeof(tDBNode)) problem("File is too small for its " + std::to_string(header.numNodes) + " nodes");
+	if (numProblems) return numProblems;
+	size_t numNodes = header.numNodes;
+
+	auto isInFile = [&](size_t offset, size_t length) {
+		return offset <= size && length <= size - offset;
+	};
+	auto isValidName = [&](size_t offset) {
+		return offset < size && memchr(data + offset, 0, size - offset);
+	};
+	auto isValidNodeOffset = [&](size_t id, int offset) {
+		auto target = (int64_t)id + offset;
+		return target >= 0 && target < numNodes;
+	};
+
+	std::vector<int64_t> parents(numNodes, -1);
+	for (size_t i = 0; i < numNodes; i++) {
+		auto nodePosition = sizeof(header) + i * sizeof(tDBNode);
+		tDBNode node;
+		memcpy(&node, data + nodePosition, sizeof(node));
+		auto nodeName = "Node " + std::to_string(i);
+
+		if (node.pNameString && !isValidName(nodePosition + node.pNameString)) problem(nodeName + " has its name out of bounds");
+		if (isValidNodeOffset(i, node.parentOffset)) parents[i] = i + node.parentOffset;
+		else problem(nodeName + " has its parent out of bounds");
+		if (!isValidNodeOffset(i, node.lastChildOffset)) problem(nodeName + " has its last child out of bounds");
+		if (!isValidNodeOffset(i, node.prevNodeOffset)) problem(nodeName + " has its previous node out of bounds");
+
+		auto valuePosition = nodePosition + node.pValues;
+		for (int j = 0; j < node.dataCount; j++) {
+			auto valueName = nodeName + " value " + std::to_string(j);
+			if (!isInFile(valuePosition, sizeof(tDBValue))) {
+				problem(valueName + " is out of bounds");
+				break;
+			}
+			tDBValue value;
+			memcpy(&value, data + valuePosition, sizeof(value));
+			auto valueData = valuePosition + sizeof(tDBValue);
+			if (!isInFile(valueData, value.size)) {
+				problem(valueName + " has its data out of bounds");
+				break;
+			}
+			if (value.pNameString && !isValidName(valuePosition + value.pNameString)) problem(valueName + " has its name out of bounds");
+
+			auto typeSize = GetDBValueTypeSize(value.valueType);
+			if (!typeSize) problem(valueName + " has unknown type " + std::to_string(value.valueType));
+			else if (value.size % typeSize != 0) problem(valueName + " is " + std::to_string(value.size) + " bytes, not a multiple of " + std::to_string(typeSize));
+			else if (value.arrayType == DBARRAY_SINGLE && value.valueType != DBVALUE_STRING && value.size != typeSize) problem(valueName + " is " + std::to_string(value.size) + " bytes, expected " + std::to_string(typeSize));
+			if (value.arrayType > DBARRAY_VARIABLE) problem(valueName + " has unknown array type " + std::to_string(value.arrayType));
+
+			if (value.valueType == DBVALUE_STRING && !memchr(data + valueData, 0, value.size)) {
+				problem(valueName + " is a string without a terminator");
+			}
+			if (value.valueType == DBVALUE_NODE) {
+				for (size_t k = 0; k + 2 <= value.size; k += 2) {
+					uint16_t id;
+					memcpy(&id, data + valueData + k, 2);
+					if (id >= numNodes) problem(valueName + " points to node " + std::to_string(id) + " of " + std::to_string(numNodes));
+				}
+			}
+			valuePosition = valueData + value.size;
+		}
+	}
+
+	// every chain has to end at the root, each node is only walked once and then remembered
+	enum { CHAIN_UNKNOWN, CHAIN_VISITING, CHAIN_VALID, CHAIN_INVALID };
+	std::vector<uint8_t> states(numNodes, CHAIN_UNKNOWN);
+	std::vector<size_t> chain;
+	for (size_t i = 0; i < numNodes; i++) {
+		auto id = i;
+		while (states[id] == CHAIN_UNKNOWN) {
+			states[id] = CHAIN_VISITING;
+			chain.push_back(id);
+			if (id == 0) break;
+			if (parents[id] < 0 || parents[id] == id) break;
+			id = parents[id];
+		}
+
+		// reaching a node that's still being visited means the chain loops
+		bool isValid = id == 0 || states[id] == CHAIN_VALID;
+		if (!chain.empty() && id == chain.back() && id != 0) isValid = false;
+		for (auto chainId : chain) {
+			states[chainId] = isValid ? CHAIN_VALID : CHAIN_INVALID;
+		}
+		if (!isValid && !chain.empty()) problem("Node " + std::to_string(i) + " has a parent chain that doesn't reach the root");
+		chain.clear();
+	}
+	return numProblems;
+}
+
+std::atomic<uint64_t> nNextArenaId = 1;
+
+tArena::tArena() : nId(nNextArenaId++) {}
+
+// the block this thread is filling in one arena
+struct tArenaCursor {
+	char* block = nullptr;
+	size_t used = tArena::nBlockSize;
+	std::weak_ptr<void> arenaLifetime;
+};
+
+// one cursor for every arena this thread has allocated from, with the last one used kept at hand
+struct tArenaThreadCursors {
+	std::unordered_map<uint64_t, tArenaCursor> cursors;
+	uint64_t lastArenaId = 0;
+	tArenaCursor* last = nullptr;
+};
+thread_local tArenaThreadCursors threadArenaCursors;
+
+void* tArena::Allocate(size_t size, size_t alignment) {
+	// anything big enough to waste most of a block gets its own
+	if (size > nBlockSize / 4) {
+		std::lock_guard lock(mutex);
+		return aBlocks.emplace_back(std::make_unique_for_overwrite<char[]>(size)).get();
+	}
+
+	auto& own = threadArenaCursors;
+	if (own.lastArenaId != nId) {
+		auto [it, isNew] = own.cursors.try_emplace(nId);
+		if (isNew) it->second.arenaLifetime = pLifetime;
+		own.lastArenaId = nId;
+		own.last = &it->second;
+	}
+
+	auto& cursor = *own.last;
+	auto offset = (cursor.used + alignment - 1) & ~(alignment - 1);
+	if (offset + size > nBlockSize) {
+		{
+			std::lock_guard lock(mutex);
+			cursor.block = aBlocks.emplace_back(std::make_unique_for_overwrite<char[]>(nBlockSize)).get();
+		}
+		offset = 0;
+
+		// cursors for arenas that are gone are only cleaned up here, once a thread has been through a few of them
+		if (own.cursors.size() > 16) {
+			std::erase_if(own.cursors, [](const auto& it) { return it.second.arenaLifetime.expired(); });
+		}
+	}
+	cursor.used = offset + size;
+	return cursor.block + offset;
+}
+
+std::string GetNodePathKey(const std::filesystem::path& path) {
+	return path.lexically_normal().generic_string();
+}
+
+tDBNodeTemp* GetNodeForPath(tDBTree& db, const std::filesystem::path& path, bool createNew) {
+	auto key = GetNodePathKey(path);
+	auto it = db.mNodeIdsByPath.find(key);
+	if (it != db.mNodeIdsByPath.end()) return &db.aNodes[it->second];
+
+	if (!createNew) return nullptr;
+	db.mNodeIdsByPath[key] = db.aNodes.size();
+	db.aNodes.push_back({});
+	auto node = &db.aNodes[db.aNodes.size()-1];
+	node->fullPath = path;
+	node->name = path.filename().string();
+	return node;
+}
+
+void GenerateNodesToGetToRoot(tDBTree& db, const std::filesystem::path& path) {
+	// ids rather than pointers, creating a parent can reallocate db.aNodes
+	int nodeId = GetNodeForPath(db, path, true) - &db.aNodes[0];
+	auto currPath = path;
+	while (currPath != db.aNodes[0].fullPath) {
+		currPath = currPath.parent_path();
+		auto numNodes = db.aNodes.size();
+		int parentId = GetNodeForPath(db, currPath, true) - &db.aNodes[0];
+		db.aNodes[nodeId].parentNodeId = parentId;
+		nodeId = parentId;
+
+		// an existing parent already has its chain up to the root
+		if (db.aNodes.size() == numNodes) break;
+	}
+}
+
+tDBNodeTemp* FindDBTreeNode(tDBTree& db, std::string_view path) {
+	return GetNodeForPath(db, db.dbBaseFolderPath / path, false);
+}
+
+tDBNodeTemp* AddDBTreeNode(tDBTree& db, std::string_view path) {
+	auto rootName = path.substr(0, path.find('/'));
+	if (db.aNodes.empty()) GetNodeForPath(db, db.dbBaseFolderPath / rootName, true)->parentNodeId = 0;
+	// anything outside the root would never reach it
+	if (rootName != db.aNodes[0].name) return nullptr;
+
+	// parents are created before their children, LinkDBNodes only links children that come after their parent
+	int nodeId = 0;
+	for (auto end = path.find('/'); end != std::string_view::npos; ) {
+		end = path.find('/', end + 1);
+		auto numNodes = db.aNodes.size();
+		auto node = GetNodeForPath(db, db.dbBaseFolderPath / path.substr(0, end), true);
+		if (db.aNodes.size() != numNodes) node->parentNodeId = nodeId;
+		nodeId = node - &db.aNodes[0];
+	}
+	return &db.aNodes[nodeId];
+}
+
+tDBValueTemp* FindDBTreeValue(tDBNodeTemp& node, std::string_view name) {
+	for (auto& value : node.values) {
+		if (value.name == name) return &value;
+	}
+	return nullptr;
+}
+
+tDBValueTemp& SetDBTreeValue(tDBTree& db, tDBNodeTemp& node, std::string_view name, int type, const void* data, int arrayCount) {
+	auto value = FindDBTreeValue(node, name);
+	if (!value) {
+		value = &node.values.emplace_back();
+		value->name = name;
+	}
+	auto size = arrayCount * GetDBValueTypeSize(type);
+	value->type = type;
+	value->arrayType = -1;
+	value->arrayCount = arrayCount;
+	value->data = db.valueArena.Allocate(size, 8);
+	memcpy(value->data, data, size);
+	value->nodePaths.clear();
+	return *value;
+}
+
+bool RemoveDBTreeValue(tDBNodeTemp& node, std::string_view name) {
+	auto value = FindDBTreeValue(node, name);
+	if (!value) return false;
+	node.values.erase(node.values.begin() + (value - &node.values[0]));
+	return true;
+}
+
+bool RemoveDBTreeNode(tDBTree& db, int nodeId, std::string& outError) {
+	if (nodeId <= 0 || nodeId >= db.aNodes.size()) {
+		outError = nodeId == 0 ? "The root node can't be removed" : "No node " + std::to_string(nodeId);
+		return false;
+	}
+
+	// parents can come after their children, so each node walks up until it finds out which side it's on
+	enum { REMOVE_UNKNOWN, REMOVE_KEEP, REMOVE_YES };
+	std::vector<uint8_t> states(db.aNodes.size(), REMOVE_UNKNOWN);
+	states[0] = REMOVE_KEEP;
+	states[nodeId] = REMOVE_YES;
+	std::vector<int> chain;
+	for (int i = 0; i < db.aNodes.size(); i++) {
+		int id = i;
+		while (states[id] == REMOVE_UNKNOWN && db.aNodes[id].parentNodeId != id) {
+			chain.push_back(id);
+			id = db.aNodes[id].parentNodeId;
+		}
+		auto state = states[id] == REMOVE_YES ? REMOVE_YES : REMOVE_KEEP;
+		for (auto chainId : chain) {
+			states[chainId] = state;
+		}
+		chain.clear();
+	}
+
+	std::vector<int> newIds(db.aNodes.size(), -1);
+	int numKept = 0;
+	for (int i = 0; i < db.aNodes.size(); i++) {
+		if (states[i] == REMOVE_KEEP) newIds[i] = numKept++;
+	}
+	for (auto& node : db.aNodes) {
+		if (states[&node - &db.aNodes[0]] == REMOVE_YES) continue;
+		for (auto& value : node.values) {
+			if (value.type != DBVALUE_NODE || !value.data) continue;
+			for (int i = 0; i < value.arrayCount; i++) {
+				auto id = ((uint16_t*)value.data)[i];
+				if (id < newIds.size() && newIds[id] < 0) {
+					outError = value.name + " in " + node.name + " still points to " + db.aNodes[id].name;
+					return false;
+				}
+			}
+		}
+	}
+
+	// nothing is changed until every reference is known to survive
+	std::vector<tDBNodeTemp> nodes;
+	nodes.reserve(numKept);
+	for (int i = 0; i < db.aNodes.size(); i++) {
+		if (newIds[i] < 0) continue;
+		auto& node = nodes.emplace_back(std::move(db.aNodes[i]));
+		node.parentNodeId = newIds[node.parentNodeId];
+		for (auto& value : node.values) {
+			if (value.type != DBVALUE_NODE || !value.data) continue;
+			for (int j = 0; j < value.arrayCount; j++) {
+				auto& id = ((uint16_t*)value.data)[j];
+				if (id < newIds.size()) id = newIds[id];
+			}
+		}
+	}
+	db.aNodes = std::move(nodes);
+	db.mNodeIdsByPath.clear();
+	for (int i = 0; i < db.aNodes.size(); i++) {
+		db.mNodeIdsByPath[GetNodePathKey(db.aNodes[i].fullPath)] = i;
+	}
+	return true;
+}
+
+void ReadDBTree(const tDBFile& file, tDBTree& db) {
+	db.aNodes.resize(file.nNumNodes);
+	db.mNodeIdsByPath.reserve(file.nNumNodes);
+	for (size_t i = 0; i < file.nNumNodes; i++) {
+		auto in = &file.pRootNode[i];
+		auto& node = db.aNodes[i];
+		node.name = in->GetName();
+		node.fullPath = db.dbBaseFolderPath / file.aNodePaths[i];
+		db.mNodeIdsByPath.try_emplace(GetNodePathKey(node.fullPath), i);
+
+		auto parentId = in->GetParent()->GetId(file);
+		node.parentNodeId = parentId < file.nNumNodes ? parentId : 0;
+
+		node.values.resize(in->dataCount);
+		for (int j = 0; j < in->dataCount; j++) {
+			auto value = in->GetValue(file, j);
+			auto& out = node.values[j];
+			out.name = value->GetName();
+			out.type = value->valueType;
+			out.arrayType = value->arrayType;
+			auto typeSize = value->GetValueTypeSize();
+			out.arrayCount = typeSize ? value->size / typeSize : 0;
+			out.data = db.valueArena.Allocate(value->size, 8);
+			memcpy(out.data, value->data, value->size);
+		}
+	}
+}
+
+// previous sibling and last child of every node in one pass, by remembering the last node seen under each parent
+void LinkDBNodes(tDBTree& db) {
+	for (int i = 0; i < db.aNodes.size(); i++) {
+		db.aNodes[i].prevNodeId = i;
+		db.aNodes[i].lastChildId = -1;
+	}
+
+	std::vector<int> lastNodeWithParent(db.aNodes.size(), -1);
+	for (int i = 1; i < db.aNodes.size(); i++) { // the root is never anyone's previous node
+		auto& node = db.aNodes[i];
+		auto& lastSibling = lastNodeWithParent[node.parentNodeId];
+		if (lastSibling >= 0) node.prevNodeId = lastSibling;
+		lastSibling = i;
+
+		if (i > node.parentNodeId) db.aNodes[node.parentNodeId].lastChildId = i;
+	}
+}
+
+// offsets are unsigned 32 bit and relative to the record they're in, so the target has to come after it
+bool GetRelativeOffset(size_t from, size_t to, uint32_t& out) {
+	if (to < from || to - from > UINT32_MAX) return false;
+	out = to - from;
+	return true;
+}
+
+bool WriteDBTree(tDBTree& db, bool internStrings, std::vector<char>& out, tDBWriteInfo& info) {
+	auto fail = [&](const std::string& str) {
+		info.error = str;
+		return false;
+	};
+
+	tDBHeader header;
+	header.identifier = 0x1A424450;
+	header.version = 512;
+
+	// work out where everything goes first, then the whole file is built in memory with its offsets already in place
+	struct tRecordLayout {
+		size_t position = 0;
+		size_t namePosition = 0;
+		size_t valuesPosition = 0; // nodes only, 0 if there are no values
+		size_t firstValue = 0; // nodes only, index of its first value in aValueLayouts
+	};
+	std::vector<tRecordLayout> aNodeLayouts(db.aNodes.size());
+	std::vector<tRecordLayout> aValueLayouts;
+	auto getLayout = [&](const tDBNodeTemp& node) -> tRecordLayout& {
+		return aNodeLayouts[&node - &db.aNodes[0]];
+	};
+	auto getValueLayout = [&](const tDBNodeTemp& node, const tDBValueTemp& value) -> tRecordLayout& {
+		return aValueLayouts[getLayout(node).firstValue + (&value - &node.values[0])];
+	};
+
+	size_t fileSize = sizeof(header);
+	for (auto& node : db.aNodes) {
+		getLayout(node).position = fileSize;
+		fileSize += sizeof(tDBNode);
+	}
+	for (auto& node : db.aNodes) {
+		if (node.values.size() > UINT16_MAX) {
+			return fail(node.name + " has too many values (" + std::to_string(node.values.size()) + ")");
+		}
+		getLayout(node).firstValue = aValueLayouts.size();
+		aValueLayouts.resize(aValueLayouts.size() + node.values.size());
+		if (!node.values.empty()) getLayout(node).valuesPosition = fileSize;
+		for (auto& value : node.values) {
+			auto size = value.arrayCount * GetDBValueTypeSize(value.type);
+			if (size > UINT16_MAX) {
+				return fail(value.name + " in " + node.name + " is too large (" + std::to_string(size) + " bytes)");
+			}
+			if (size && !value.data) {
+				return fail("Node references in " + value.name + " in " + node.name + " aren't resolved");
+			}
+			// ids are 16 bit, UINT16_MAX is left for references that point nowhere
+			if (value.type == DBVALUE_NODE && db.aNodes.size() > UINT16_MAX) {
+				return fail("Node references in " + value.name + " in " + node.name + " can't reach every node, a db with node references can only have " + std::to_string(UINT16_MAX) + " nodes");
+			}
+			for (int i = 0; value.type == DBVALUE_NODE && i < value.arrayCount; i++) {
+				auto id = ((const uint16_t*)value.data)[i];
+				if (id != UINT16_MAX && id >= db.aNodes.size()) {
+					return fail("Node reference " + std::to_string(id) + " in " + value.name + " in " + node.name + " is out of range");
+				}
+			}
+			getValueLayout(node, value).position = fileSize;
+			fileSize += sizeof(tDBValue) + size;
+		}
+
+		if (internStrings) continue;
+
+		// node name strings
+		getLayout(node).namePosition = fileSize;
+		fileSize += node.name.length() + 1;
+		for (auto& value : node.values) {
+			getValueLayout(node, value).namePosition = fileSize;
+			fileSize += value.name.length() + 1;
+		}
+	}
+
+	// every unique name stored once at the end of the file, after every node and value that points at it
+	std::unordered_map<std::string_view, size_t> mStringPool;
+	std::vector<std::string_view> aPooledStrings;
+	auto internString = [&](const std::string& string) {
+		auto [it, isNew] = mStringPool.try_emplace(string, fileSize);
+		if (isNew) {
+			aPooledStrings.push_back(string);
+			fileSize += string.length() + 1;
+		}
+		return it->second;
+	};
+	if (internStrings) {
+		for (auto& node : db.aNodes) {
+			getLayout(node).namePosition = internString(node.name);
+			for (auto& value : node.values) {
+				getValueLayout(node, value).namePosition = internString(value.name);
+			}
+			info.numNames += node.values.size() + 1;
+		}
+		info.numUniqueNames = aPooledStrings.size();
+	}
+
+	if (fileSize > UINT32_MAX) {
+		return fail("Database is too large (" + std::to_string(fileSize) + " bytes)");
+	}
+
+	LinkDBNodes(db);
+
+	auto& file = out;
+	file.assign(fileSize, 0);
+
+	header.numNodes = db.aNodes.size();
+	memcpy(&file[0], &header, sizeof(header));
+
+	for (auto& node : db.aNodes) {
+		auto& layout = getLayout(node);
+		tDBNode nodeOut;
+		nodeOut.dataCount = node.values.size();
+		if (!GetRelativeOffset(layout.position, layout.namePosition, nodeOut.pNameString)) {
+			return fail("Name of " + node.name + " is out of range of its node");
+		}
+		if (layout.valuesPosition && !GetRelativeOffset(layout.position, layout.valuesPosition, nodeOut.pValues)) {
+			return fail("Values of " + node.name + " are out of range of their node");
+		}
+		// links are 16 bit offsets, so the nodes they connect can't be too far apart in the node table
+		int myId = &node - &db.aNodes[0];
+		int parentOffset = node.parentNodeId - myId;
+		int prevNodeOffset = node.prevNodeId - myId;
+		int lastChildOffset = node.lastChildId >= 0 ? node.lastChildId - myId : 0;
+		for (auto offset : {parentOffset, prevNodeOffset, lastChildOffset}) {
+			if (offset < INT16_MIN || offset > INT16_MAX) {
+				return fail(node.name + " is too far from its parent or siblings in the node table (" + std::to_string(offset) + " nodes)");
+			}
+		}
+		nodeOut.parentOffset = parentOffset;
+		nodeOut.prevNodeOffset = prevNodeOffset;
+		nodeOut.lastChildOffset = lastChildOffset;
+		memcpy(&file[layout.position], &nodeOut, sizeof(tDBNode));
+
+		for (auto& value : node.values) {
+			auto& valueLayout = getValueLayout(node, value);
+			uint32_t nameOffset;
+			if (!GetRelativeOffset(valueLayout.position, valueLayout.namePosition, nameOffset)) {
+				return fail("Name of " + value.name + " in " + node.name + " is out of range of its value");
+			}
+
+			tDBValue valueOut;
+			valueOut.pNameString = nameOffset;
+			valueOut.valueType = value.type;
+			valueOut.size = value.arrayCount * GetDBValueTypeSize(value.type);
+			if (value.arrayType >= 0) valueOut.arrayType = value.arrayType;
+			else {
+				valueOut.arrayType = value.arrayCount > 1 ? 1 : 0;
+				if (value.type == DBVALUE_STRING) valueOut.arrayType = 2; // strings are always variable length arrays for now
+			}
+			memcpy(&file[valueLayout.position], &valueOut, sizeof(tDBValue));
+			if (valueOut.size) memcpy(&file[valueLayout.position + sizeof(tDBValue)], value.data, valueOut.size);
+		}
+
+		if (internStrings) continue;
+
+		memcpy(&file[layout.namePosition], node.name.c_str(), node.name.length() + 1);
+		for (auto& value : node.values) {
+			memcpy(&file[getValueLayout(node, value).namePosition], value.name.c_str(), value.name.length() + 1);
+		}
+	}
+	for (auto& string : aPooledStrings) {
+		memcpy(&file[mStringPool[string]], string.data(), string.length()); // the buffer is already zeroed
+	}
+	return true;
+}
+
+bool PatchDB(const tDBFile& db, const std::vector<tDBValueEdit>& edits, std::vector<char>& out, tDBPatchInfo& info) {
+	auto fail = [&](const std::string& str) {
+		info.error = str;
+		return false;
+	};
+	auto data = db.pData;
+	auto getPosition = [&](const void* ptr) {
+		return (size_t)((const char*)ptr - data);
+	};
+
+	// the values every edited node ends up with, in order
+	struct tEntry {
+		const tDBValue* original;
+		const tDBValueEdit* edit;
+	};
+	std::unordered_map<int, std::vector<tEntry>> mNodeEntries;
+	std::vector<int> aEditedNodes;
+	for (auto& edit : edits) {
+		if (edit.nodeId < 0 || edit.nodeId >= db.nNumNodes) return fail("No node " + std::to_string(edit.nodeId));
+		auto node = &db.pRootNode[edit.nodeId];
+		auto [it, isNew] = mNodeEntries.try_emplace(edit.nodeId);
+		auto& entries = it->second;
+		if (isNew) {
+			aEditedNodes.push_back(edit.nodeId);
+			for (int i = 0; i < node->dataCount; i++) {
+				entries.push_back({node->GetValue(db, i), nullptr});
+			}
+		}
+
+		auto entry = std::find_if(entries.begin(), entries.end(), [&](const tEntry& entry) {
+			return (entry.original ? std::string_view(entry.original->GetName()) : entry.edit->name) == edit.name;
+		});
+		if (edit.remove) {
+			if (entry == entries.end()) return fail("No value " + edit.name + " in " + node->GetFullPath(db));
+			entries.erase(entry);
+			continue;
+		}
+
+		auto typeSize = GetDBValueTypeSize(edit.type);
+		if (!typeSize) return fail("Unknown type " + std::to_string(edit.type) + " for " + edit.name);
+		if (edit.data.size() != edit.arrayCount * typeSize) return fail("Data of " + edit.name + " doesn't match its type and array size");
+		if (edit.data.size() > UINT16_MAX) return fail(edit.name + " in " + node->GetFullPath(db) + " is too large (" + std::to_string(edit.data.size()) + " bytes)");
+		for (int i = 0; edit.type == DBVALUE_NODE && i < edit.arrayCount; i++) {
+			auto id = ((const uint16_t*)edit.data.data())[i];
+			if (id != UINT16_MAX && id >= db.nNumNodes) return fail("Node reference " + std::to_string(id) + " in " + edit.name + " is out of range");
+		}
+		if (entry != entries.end()) entry->edit = &edit;
+		else entries.push_back({nullptr, &edit});
+		if (entries.size() > UINT16_MAX) return fail(node->GetFullPath(db) + " has too many values (" + std::to_string(entries.size()) + ")");
+	}
+
+	auto getArrayType = [](const tEntry& entry) {
+		auto edit = entry.edit;
+		if (edit->arrayType >= 0) return edit->arrayType;
+		if (entry.original && entry.original->valueType == edit->type) return (int)entry.original->arrayType;
+		if (edit->type == DBVALUE_STRING) return (int)DBARRAY_VARIABLE;
+		return edit->arrayCount > 1 ? (int)DBARRAY_FIXED : (int)DBARRAY_SINGLE;
+	};
+	auto writeValue = [&](size_t position, const tEntry& entry, uint32_t nameOffset) {
+		tDBValue valueOut;
+		valueOut.pNameString = nameOffset;
+		if (entry.edit) {
+			valueOut.valueType = entry.edit->type;
+			valueOut.size = entry.edit->data.size();
+			valueOut.arrayType = getArrayType(entry);
+		}
+		else {
+			valueOut.valueType = entry.original->valueType;
+			valueOut.size = entry.original->size;
+			valueOut.arrayType = entry.original->arrayType;
+		}
+		memcpy(&out[position], &valueOut, sizeof(tDBValue));
+		memcpy(&out[position + sizeof(tDBValue)], entry.edit ? entry.edit->data.data() : entry.original->data, valueOut.size);
+		return position + sizeof(tDBValue) + valueOut.size;
+	};
+
+	// nodes that keep the same values at the same sizes are left where they are, the rest get their value records replaced
+	struct tSplice {
+		int nodeId;
+		size_t start;
+		size_t oldLength;
+		size_t newLength = 0;
+		size_t newStart = 0;
+	};
+	std::vector<tSplice> aSplices;
+	std::vector<uint8_t> aIsRewritten(db.nNumNodes);
+	for (auto nodeId : aEditedNodes) {
+		auto node = &db.pRootNode[nodeId];
+		auto& entries = mNodeEntries[nodeId];
+		bool isInPlace = entries.size() == node->dataCount;
+		for (int i = 0; i < entries.size() && isInPlace; i++) {
+			auto& entry = entries[i];
+			if (entry.original != node->GetValue(db, i) || (entry.edit && entry.edit->data.size() != entry.original->size)) isInPlace = false;
+		}
+		if (isInPlace) continue;
+		if (entries.size() > UINT16_MAX) return fail("Too many values in " + node->GetFullPath(db));
+
+		tSplice splice = {nodeId, db.nDataSize, 0};
+		if (node->dataCount) {
+			auto first = node->GetValue(db, 0);
+			auto last = node->GetValue(db, node->dataCount - 1);
+			splice.start = getPosition(first);
+			splice.oldLength = getPosition(last) + sizeof(tDBValue) + last->size - splice.start;
+		}
+		for (auto& entry : entries) {
+			splice.newLength += sizeof(tDBValue) + (entry.edit ? entry.edit->data.size() : entry.original->size);
+		}
+		aSplices.push_back(splice);
+		aIsRewritten[nodeId] = true;
+	}
+	std::stable_sort(aSplices.begin(), aSplices.end(), [](const tSplice& a, const tSplice& b) { return a.start < b.start; });
+
+	// everything between the rebuilt records is copied over as it is
+	auto nodeTableEnd = sizeof(tDBHeader) + db.nNumNodes * sizeof(tDBNode);
+	size_t newSize = db.nDataSize;
+	for (auto& splice : aSplices) {
+		newSize += splice.newLength - splice.oldLength;
+	}
+	size_t namesStart = newSize;
+	for (auto& splice : aSplices) {
+		for (auto& entry : mNodeEntries[splice.nodeId]) {
+			if (!entry.original) newSize += entry.edit->name.length() + 1;
+		}
+	}
+	if (newSize > UINT32_MAX) return fail("Database is too large (" + std::to_string(newSize) + " bytes)");
+
+	out.resize(newSize);
+	size_t readPosition = 0, writePosition = 0;
+	for (auto& splice : aSplices) {
+		if (splice.start < readPosition || splice.start < nodeTableEnd) {
+			return fail("Values of " + db.pRootNode[splice.nodeId].GetFullPath(db) + " overlap something else, it needs a full repack");
+		}
+		memcpy(&out[writePosition], data + readPosition, splice.start - readPosition);
+		writePosition += splice.start - readPosition;
+		splice.newStart = writePosition;
+		writePosition += splice.newLength;
+		readPosition = splice.start + splice.oldLength;
+	}
+	memcpy(&out[writePosition], data + readPosition, db.nDataSize - readPosition);
+
+	// where a position in the original file ended up, false if it was inside records that were rebuilt
+	auto remap = [&](size_t position, size_t& outPosition) {
+		auto it = std::upper_bound(aSplices.begin(), aSplices.end(), position, [](size_t position, const tSplice& splice) { return position < splice.start; });
+		if (it == aSplices.begin()) {
+			outPosition = position;
+			return true;
+		}
+		auto& splice = *(it - 1);
+		if (position == splice.start) outPosition = splice.newStart;
+		else if (position >= splice.start + splice.oldLength) outPosition = splice.newStart + splice.newLength + (position - splice.start - splice.oldLength);
+		else return false;
+		return true;
+	};
+	auto getNewOffset = [&](size_t from, size_t oldFrom, uint32_t oldOffset, uint32_t& outOffset) {
+		size_t to;
+		if (!remap(oldFrom + oldOffset, to) || to < from || to - from > UINT32_MAX) return false;
+		outOffset = to - from;
+		return true;
+	};
+
+	// nodes never move, only what they point at
+	for (size_t i = 0; i < db.nNumNodes && !aSplices.empty(); i++) {
+		auto node = &db.pRootNode[i];
+		auto position = getPosition(node);
+		tDBNode nodeOut;
+		memcpy(&nodeOut, node, sizeof(tDBNode));
+		if (node->pNameString && !getNewOffset(position, position, node->pNameString, nodeOut.pNameString)) {
+			return fail("Name of " + node->GetFullPath(db) + " is inside values that changed size, it needs a full repack");
+		}
+		if (!aIsRewritten[i]) {
+			if (node->dataCount && !getNewOffset(position, position, node->pValues, nodeOut.pValues)) {
+				return fail("Values of " + node->GetFullPath(db) + " are inside values that changed size, it needs a full repack");
+			}
+
+			for (int j = 0; j < node->dataCount; j++) {
+				auto value = node->GetValue(db, j);
+				size_t valuePosition;
+				if (!remap(getPosition(value), valuePosition)) {
+					return fail("Values of " + node->GetFullPath(db) + " overlap something else, it needs a full repack");
+				}
+				uint32_t nameOffset = 0;
+				if (value->pNameString && !getNewOffset(valuePosition, getPosition(value), value->pNameString, nameOffset)) {
+					return fail("Name of " + (std::string)value->GetName() + " in " + node->GetFullPath(db) + " is inside values that changed size, it needs a full repack");
+				}
+				memcpy(&out[valuePosition], &nameOffset, sizeof(nameOffset));
+			}
+		}
+		memcpy(&out[position], &nodeOut, sizeof(tDBNode));
+	}
+
+	size_t namePosition = namesStart;
+	for (auto& splice : aSplices) {
+		auto node = &db.pRootNode[splice.nodeId];
+		auto position = getPosition(node);
+		auto& entries = mNodeEntries[splice.nodeId];
+		tDBNode nodeOut;
+		memcpy(&nodeOut, &out[position], sizeof(tDBNode));
+		nodeOut.dataCount = entries.size();
+		nodeOut.pValues = entries.empty() ? 0 : splice.newStart - position;
+		memcpy(&out[position], &nodeOut, sizeof(tDBNode));
+
+		auto valuePosition = splice.newStart;
+		for (auto& entry : entries) {
+			uint32_t nameOffset = 0;
+			if (!entry.original) {
+				nameOffset = namePosition - valuePosition;
+				memcpy(&out[namePosition], entry.edit->name.c_str(), entry.edit->name.length() + 1);
+				namePosition += entry.edit->name.length() + 1;
+			}
+			else if (entry.original->pNameString && !getNewOffset(valuePosition, getPosition(entry.original), entry.original->pNameString, nameOffset)) {
+				return fail("Name of " + (std::string)entry.original->GetName() + " in " + node->GetFullPath(db) + " is inside values that changed size, it needs a full repack");
+			}
+			valuePosition = writeValue(valuePosition, entry, nameOffset);
+		}
+		info.numRewrittenNodes++;
+	}
+
+	// same size values last, once it's known where they ended up
+	for (auto nodeId : aEditedNodes) {
+		if (aIsRewritten[nodeId]) continue;
+		for (auto& entry : mNodeEntries[nodeId]) {
+			if (!entry.edit) continue;
+			size_t valuePosition;
+			remap(getPosition(entry.original), valuePosition);
+			uint32_t nameOffset;
+			memcpy(&nameOffset, &out[valuePosition], sizeof(nameOffset));
+			writeValue(valuePosition, entry, nameOffset);
+			info.aOverwrites.push_back({valuePosition, sizeof(tDBValue) + entry.original->size});
+		}
+	}
+	return true;
+}
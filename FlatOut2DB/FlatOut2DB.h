@@ -0,0 +1,321 @@
+#pragma once
+
+// the db format and everything both tools do with it, usable from any program that wants to read or write dbs in-process
+// there's no global state, everything belongs to the tDBFile or tDBTree it was opened or built in,
+// so different dbs can be used from different threads at the same time
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+
+enum eDBValueType {
+	DBVALUE_CHAR = 1,
+	DBVALUE_STRING = 2,
+	DBVALUE_BOOL = 5,
+	DBVALUE_INT = 6,
+	DBVALUE_FLOAT = 7,
+	DBVALUE_RGBA = 8,
+	DBVALUE_VECTOR2 = 9,
+	DBVALUE_VECTOR3 = 10,
+	DBVALUE_VECTOR4 = 11,
+	DBVALUE_NODE = 12,
+	DBVALUE_MAX_COUNT
+};
+inline const char* aValueTypeNames[] = {
+		nullptr,
+		"char",
+		"const char",
+		nullptr,
+		nullptr,
+		"bool",
+		"int",
+		"float",
+		"rgba",
+		"vec2",
+		"vec3",
+		"vec4",
+		"node*",
+};
+
+inline bool IsDBTypeVector(int type) {
+	return type >= DBVALUE_VECTOR2 && type <= DBVALUE_VECTOR4;
+}
+
+inline size_t GetDBValueTypeSize(int type) {
+	switch (type) {
+		case DBVALUE_CHAR:
+		case DBVALUE_STRING:
+			return 1;
+		case DBVALUE_NODE:
+			return 2;
+		case DBVALUE_BOOL:
+		case DBVALUE_RGBA:
+		case DBVALUE_INT:
+		case DBVALUE_FLOAT:
+			return 4;
+		case DBVALUE_VECTOR2:
+			return 4 * 2;
+		case DBVALUE_VECTOR3:
+			return 4 * 3;
+		case DBVALUE_VECTOR4:
+			return 4 * 4;
+		default:
+			return 0;
+	}
+}
+
+enum eDBArrayType {
+	DBARRAY_SINGLE,
+	DBARRAY_FIXED,
+	DBARRAY_VARIABLE, // used for strings
+};
+
+struct tDBHeader {
+	uint32_t identifier;
+	uint32_t version;
+	uint32_t numNodes;
+};
+
+// read-only view of an entire file, mapped into memory instead of copied
+struct tMappedFile {
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* hFile = (void*)-1; // INVALID_HANDLE_VALUE
+	void* hMapping = nullptr;
+#endif
+
+	tMappedFile() = default;
+	tMappedFile(const tMappedFile&) = delete;
+	tMappedFile& operator=(const tMappedFile&) = delete;
+	~tMappedFile() { Close(); }
+
+	bool Open(const char* fileName);
+	void Close();
+};
+
+struct tDBFile;
+
+// values and nodes exactly as they're stored in the file, an opened db is read through these without copying anything
+struct __attribute__((packed, aligned(1))) tDBValue {
+	uint32_t pNameString = 0;	// +0 offset from this value
+	uint8_t valueType = 0;		// +4
+	uint16_t size = 0;			// +5 array size included
+	uint8_t arrayType = 0;		// +7
+	uint32_t dataPtr = 0;		// +8 nulled by the game's reader, only used at runtime
+	char data[0];				// +C
+
+	const char* GetName() const {
+		if (!pNameString) return "";
+		return (const char*)this + pNameString;
+	}
+
+	size_t GetValueTypeSize() const {
+		return GetDBValueTypeSize(valueType);
+	}
+
+	auto GetAsChar(int offset) const {
+		auto addr = &data[offset];
+		return *(const unsigned char*)addr;
+	}
+
+	auto GetAsShort(int offset) const {
+		auto addr = &data[offset * 2];
+		return *(const unsigned short*)addr;
+	}
+
+	auto GetAsInt(int offset) const {
+		auto addr = &data[offset * 4];
+		return *(const int*)addr;
+	}
+
+	auto GetAsFloat(int offset) const {
+		auto addr = &data[offset * 4];
+		return *(const float*)addr;
+	}
+
+	auto GetAsString(int offset) const {
+		auto addr = &data[offset];
+		return (const char*)addr;
+	}
+
+	// the same text the extractor writes into .h files
+	void WriteValueToFile(const tDBFile& db, std::string& out, int index) const;
+	void WriteToFile(const tDBFile& db, std::string& out) const;
+};
+static_assert(sizeof(tDBValue) == 0xC);
+
+struct tDBNode {
+	uint32_t vtable = 0;		// +0
+	int16_t parentOffset = 0;	// +4
+	int16_t lastChildOffset = 0;// +6
+	int16_t prevNodeOffset = 0;	// +8 usually -1, 0 if it's the first one, amount of nodes to get to the previous one in the folder
+	uint16_t dataCount = 0;		// +A
+	uint32_t pNameString = 0;	// +C offset from this node
+	uint32_t pValues = 0;		// +10 offset from this node
+
+	size_t GetId(const tDBFile& db) const;
+	bool DoesAnythingDependOnMe(const tDBFile& db) const;
+
+	const tDBNode* GetParent() const {
+		return this + parentOffset;
+	}
+
+	const char* GetName() const {
+		if (!pNameString) return "";
+		return (const char*)this + pNameString;
+	}
+
+	const tDBValue* GetValue(const tDBFile& db, int id) const;
+	const std::string& GetFullPath(const tDBFile& db) const;
+	void WriteValuesToBuffer(const tDBFile& db, std::string& out) const;
+};
+static_assert(sizeof(tDBNode) == 0x14);
+
+// one opened db and the tables built for it, nothing in here is shared between dbs
+// OpenDB builds everything in here and nothing changes it afterwards, so it can be read from several threads at once
+struct tDBFile {
+	tMappedFile file; // only used by OpenDBFile, OpenDB reads from memory the caller owns
+	std::string fileName;
+	const char* pData = nullptr; // the whole file, header included
+	size_t nDataSize = 0;
+	const tDBNode* pRootNode = nullptr;
+	size_t nNumNodes = 0;
+	std::vector<uint32_t> aNodeChildCounts; // number of nodes with each node as their parent, the root counts itself
+	std::vector<std::string> aNodePaths; // full path of each node
+	std::vector<const tDBValue*> aValues; // every value in the db, grouped by node
+	std::vector<uint32_t> aNodeFirstValues; // index into aValues for each node's first value
+	std::function<void(const std::string&)> onWarning; // bad values found while formatting, ignored if empty
+
+	const std::string& GetFullPathForDBNode(int id) const;
+	void Warn(const std::string& str) const {
+		if (onWarning) onWarning(str);
+	}
+};
+
+// checks the header and indexes the nodes and values, data has to stay valid for as long as db is used
+// nothing past the header is bounds checked, run VerifyDBData first on anything that isn't trusted
+bool OpenDB(tDBFile& db, const char* data, size_t size);
+bool OpenDBFile(tDBFile& db, const std::string& fileName);
+const tDBNode* FindChildNode(const tDBFile& db, const tDBNode* node, std::string_view name);
+const tDBNode* FindNodeByPath(const tDBFile& db, std::string_view path);
+const tDBValue* FindNodeValue(const tDBFile& db, const tDBNode* node, std::string_view name);
+
+// bounds checks everything OpenDB and the readers follow blindly, onProblem gets every problem found
+// returns the number of problems, 0 if the db is safe to open
+size_t VerifyDBData(const char* data, size_t size, const std::function<void(const std::string&)>& onProblem);
+
+// bump allocator for value data, nothing in it is freed until the tree it belongs to is gone
+// each thread fills a block of its own in every arena it uses, so the lock is only taken to get a new block
+struct tArena {
+	static constexpr size_t nBlockSize = 1024 * 1024;
+
+	std::vector<std::unique_ptr<char[]>> aBlocks;
+	std::mutex mutex;
+	const uint64_t nId; // what threads find their block in this arena by, never reused
+	std::shared_ptr<void> pLifetime = std::make_shared<char>(); // lets threads drop their blocks for arenas that are gone
+
+	tArena();
+	tArena(const tArena&) = delete;
+	tArena& operator=(const tArena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment);
+
+	template<typename T>
+	T* Allocate(size_t count = 1) {
+		return (T*)Allocate(sizeof(T) * count, alignof(T));
+	}
+
+	std::string_view Copy(std::string_view string) {
+		auto data = Allocate<char>(string.length());
+		memcpy(data, string.data(), string.length());
+		return {data, string.length()};
+	}
+};
+
+// editable form of a db, values hold their data as it's stored in the file
+// node references are node ids, or paths in nodePaths until something resolves them into ids
+struct tDBValueTemp {
+	std::string name;
+	int type = 0;
+	int arrayType = -1; // as it was read from a db, -1 picks one from the type and arrayCount
+	int arrayCount = 0;
+	void* data = nullptr;
+	std::vector<std::string_view> nodePaths; // DBVALUE_NODE targets stored in the value arena, resolved into data once every node exists
+};
+
+struct tDBNodeTemp {
+	std::filesystem::path fullPath;
+	std::string name;
+	std::vector<tDBValueTemp> values;
+	int parentNodeId = 0;
+	int prevNodeId = 0; // itself if it's the first node in its folder
+	int lastChildId = -1;
+};
+
+// one editable db, the root is always the first node
+struct tDBTree {
+	std::filesystem::path dbBaseFolderPath; // node paths are relative to this, the extracted folder when building from one
+	tArena valueArena;
+	std::vector<tDBNodeTemp> aNodes;
+	std::unordered_map<std::string, int> mNodeIdsByPath; // normalized fullPath -> index into aNodes
+};
+
+// folder walks and node references spell the same path differently, e.g. with \ and / on windows
+std::string GetNodePathKey(const std::filesystem::path& path);
+tDBNodeTemp* GetNodeForPath(tDBTree& db, const std::filesystem::path& path, bool createNew);
+void GenerateNodesToGetToRoot(tDBTree& db, const std::filesystem::path& path);
+
+// the same root/Path/To/Node paths as the extractor uses, AddDBTreeNode also creates any missing parents
+tDBNodeTemp* FindDBTreeNode(tDBTree& db, std::string_view path);
+tDBNodeTemp* AddDBTreeNode(tDBTree& db, std::string_view path);
+tDBValueTemp* FindDBTreeValue(tDBNodeTemp& node, std::string_view name);
+// copies arrayCount entries of type into the tree, replacing the value with the same name if there is one
+tDBValueTemp& SetDBTreeValue(tDBTree& db, tDBNodeTemp& node, std::string_view name, int type, const void* data, int arrayCount);
+bool RemoveDBTreeValue(tDBNodeTemp& node, std::string_view name);
+// removes the node and everything under it, fails if a remaining value still points at any of them
+bool RemoveDBTreeNode(tDBTree& db, int nodeId, std::string& outError);
+
+// copies an opened db into db, which should be empty
+void ReadDBTree(const tDBFile& file, tDBTree& db);
+
+// sizes WriteDBTree reports back, and why it failed if it did
+struct tDBWriteInfo {
+	std::string error;
+	size_t numNames = 0; // with internStrings, every node and value name written and the unique strings they ended up as
+	size_t numUniqueNames = 0;
+};
+
+void LinkDBNodes(tDBTree& db);
+// lays out and builds the whole file in memory, node references have to be resolved already
+bool WriteDBTree(tDBTree& db, bool internStrings, std::vector<char>& out, tDBWriteInfo& info);
+
+// a change to one value of an opened db, see PatchDB
+struct tDBValueEdit {
+	int nodeId = 0;
+	std::string name;
+	bool remove = false; // removes the value, nothing below is used
+	int type = 0;
+	int arrayType = -1; // -1 keeps the old one if the type stays the same, otherwise picks one like WriteDBTree
+	int arrayCount = 0;
+	std::string data; // as it's stored in the file, node references as ids
+};
+
+// what PatchDB did, when no nodes were rewritten the output only differs from the original in aOverwrites
+struct tDBPatchInfo {
+	std::string error;
+	std::vector<std::pair<size_t, size_t>> aOverwrites; // position and size of every value record overwritten in place
+	size_t numRewrittenNodes = 0;
+};
+
+// applies the edits to an opened db without going through a tree, in order, so a later edit to the same value wins
+// values that keep their size are overwritten in place, a node whose values change size gets only its value records rebuilt
+// and every offset pointing past them moved, names of added values go at the end of the file
+bool PatchDB(const tDBFile& db, const std::vector<tDBValueEdit>& edits, std::vector<char>& out, tDBPatchInfo& info);
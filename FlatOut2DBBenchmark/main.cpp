@@ -0,0 +1,549 @@
+#include <vector>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <cstdio>
+#include <unordered_map>
+#include <chrono>
+#include "../FlatOut2DBExtractor/extractor.h"
+#include "../FlatOut2DBMaker/maker.h"
+
+// shape of the db written by GenerateSyntheticDB, every part of it comes from the seed
+struct tSyntheticDBOptions {
+	int numNodes = 20000; // node offsets are 16 bit, so this stays below 32768
+	int maxDepth = 6;
+	int valuesPerNode = 4; // average, each node gets anywhere between none and twice this many
+	double arrayChance = 0.1;
+	int maxArrayLength = 8;
+	double nodeRefChance = 0.05; // how many values are node references, the rest follow aTypeWeights
+	int aTypeWeights[DBVALUE_MAX_COUNT] = {
+			0,
+			1, // char
+			2, // const char
+			0,
+			0,
+			1, // bool
+			3, // int
+			3, // float
+			1, // rgba
+			1, // vec2
+			1, // vec3
+			1, // vec4
+			0, // node*, see nodeRefChance
+	};
+	uint32_t seed = 1;
+};
+
+bool CanBeDBArray(int type) {
+	return type == DBVALUE_CHAR || type == DBVALUE_INT || type == DBVALUE_FLOAT || type == DBVALUE_NODE || IsDBTypeVector(type);
+}
+
+// a complete PDB1 file, built as a tree and written by the same code as the maker uses
+bool GenerateSyntheticDB(const tSyntheticDBOptions& options, std::string& out) {
+	std::mt19937 random(options.seed);
+	auto chance = [&](double probability) {
+		return std::uniform_real_distribution<double>(0, 1)(random) < probability;
+	};
+	auto range = [&](int min, int max) {
+		return std::uniform_int_distribution<int>(min, max)(random);
+	};
+	std::discrete_distribution<int> typeDistribution(std::begin(options.aTypeWeights), std::end(options.aTypeWeights));
+
+	auto numNodes = std::clamp(options.numNodes, 1, 32767);
+	tDBTree db;
+	db.aNodes.resize(numNodes);
+	db.aNodes[0].name = "root";
+	std::vector<int> aNodeDepths(numNodes);
+	std::vector<int> aPossibleParents = {0};
+	std::string data;
+	for (int i = 0; i < numNodes; i++) {
+		auto& node = db.aNodes[i];
+		if (i > 0) {
+			node.parentNodeId = aPossibleParents[range(0, aPossibleParents.size() - 1)];
+			aNodeDepths[i] = aNodeDepths[node.parentNodeId] + 1;
+			node.name = "Node" + std::to_string(i);
+			if (aNodeDepths[i] < options.maxDepth) aPossibleParents.push_back(i);
+		}
+
+		auto numValues = range(0, options.valuesPerNode * 2);
+		for (int j = 0; j < numValues; j++) {
+			auto& value = node.values.emplace_back();
+			value.name = "Value" + std::to_string(j);
+			value.type = chance(options.nodeRefChance) ? DBVALUE_NODE : typeDistribution(random);
+			value.arrayCount = 1;
+			if (CanBeDBArray(value.type) && options.maxArrayLength >= 2 && chance(options.arrayChance)) {
+				value.arrayCount = range(2, options.maxArrayLength);
+			}
+			// the maker only reads chars as arrays
+			if (value.type == DBVALUE_CHAR && value.arrayCount < 2) value.arrayCount = std::max(2, options.maxArrayLength);
+
+			data.clear();
+			auto append = [&](const auto& entry) {
+				data.append((const char*)&entry, sizeof(entry));
+			};
+			// floats are kept to 6 significant digits so they read back the same after extracting
+			auto randomFloat = [&]() {
+				return (float)(range(-999999, 999999) / 100.0);
+			};
+			for (int k = 0; k < value.arrayCount; k++) {
+				switch (value.type) {
+					case DBVALUE_CHAR: append((uint8_t)range(0, 255)); break;
+					case DBVALUE_BOOL: append((uint32_t)range(0, 1)); break;
+					case DBVALUE_INT: append((int)range(-100000, 100000)); break;
+					case DBVALUE_FLOAT: append(randomFloat()); break;
+					case DBVALUE_RGBA: append((uint32_t)random()); break;
+					case DBVALUE_NODE: append((uint16_t)range(0, numNodes - 1)); break;
+					case DBVALUE_VECTOR2:
+					case DBVALUE_VECTOR3:
+					case DBVALUE_VECTOR4: {
+						for (int l = 0; l < (value.type - DBVALUE_VECTOR2) + 2; l++) {
+							append(randomFloat());
+						}
+					} break;
+					case DBVALUE_STRING: {
+						auto length = range(0, 24);
+						for (int l = 0; l < length; l++) {
+							data += (char)('a' + range(0, 25));
+						}
+						data += '\0';
+						value.arrayCount = data.length();
+						k = value.arrayCount;
+					} break;
+					default: break;
+				}
+			}
+			value.data = (void*)db.valueArena.Copy(data).data();
+		}
+	}
+
+	std::vector<char> file;
+	tDBWriteInfo info;
+	if (!WriteDBTree(db, false, file, info)) {
+		return ReportError("Failed to generate db, " + info.error);
+	}
+	out.assign(file.begin(), file.end());
+	return true;
+}
+
+bool ParseTypeWeights(std::string_view string, tSyntheticDBOptions& options) {
+	std::fill(std::begin(options.aTypeWeights), std::end(options.aTypeWeights), 0);
+	while (!string.empty()) {
+		auto end = string.find(',');
+		auto entry = string.substr(0, end);
+		string.remove_prefix(end == std::string_view::npos ? string.length() : end + 1);
+
+		auto split = entry.find('=');
+		if (split == std::string_view::npos) return false;
+		auto name = entry.substr(0, split);
+		int type = 0;
+		for (int i = 0; i < DBVALUE_MAX_COUNT; i++) {
+			if (aValueTypeNames[i] && name == aValueTypeNames[i]) type = i;
+		}
+		if (name == "string") type = DBVALUE_STRING;
+		if (!type || type == DBVALUE_NODE) return false;
+		auto weight = entry.substr(split + 1);
+		if (std::from_chars(weight.data(), weight.data() + weight.length(), options.aTypeWeights[type]).ec != std::errc()) return false;
+	}
+	return true;
+}
+
+// generator options shared by both modes, returns false if arg isn't one of them
+bool ParseGeneratorOption(int argc, char *argv[], int& i, tSyntheticDBOptions& options) {
+	std::string arg = argv[i];
+	if (i + 1 >= argc) return false;
+	if (arg == "--nodes") options.numNodes = std::atoi(argv[++i]);
+	else if (arg == "--depth") options.maxDepth = std::atoi(argv[++i]);
+	else if (arg == "--values") options.valuesPerNode = std::atoi(argv[++i]);
+	else if (arg == "--array-chance") options.arrayChance = std::atof(argv[++i]);
+	else if (arg == "--array-length") options.maxArrayLength = std::atoi(argv[++i]);
+	else if (arg == "--node-refs") options.nodeRefChance = std::atof(argv[++i]);
+	else if (arg == "--seed") options.seed = std::strtoul(argv[++i], nullptr, 10);
+	else if (arg == "--types") {
+		if (!ParseTypeWeights(argv[++i], options)) {
+			WriteConsole("ERROR: Invalid type mix " + (std::string)argv[i] + ", expected e.g. int=3,float=3,string=1");
+			exit(1);
+		}
+	}
+	else return false;
+	return true;
+}
+
+std::string GetGeneratorOptionsString(const tSyntheticDBOptions& options) {
+	std::string out = "nodes=" + std::to_string(options.numNodes) + " depth=" + std::to_string(options.maxDepth) + " values=" + std::to_string(options.valuesPerNode);
+	out += " array-chance=" + std::to_string(options.arrayChance) + " array-length=" + std::to_string(options.maxArrayLength);
+	out += " node-refs=" + std::to_string(options.nodeRefChance) + " seed=" + std::to_string(options.seed) + " types=";
+	for (int i = 0; i < DBVALUE_MAX_COUNT; i++) {
+		if (!options.aTypeWeights[i]) continue;
+		if (!out.ends_with('=')) out += ',';
+		out += (i == DBVALUE_STRING ? "string" : aValueTypeNames[i]) + (std::string)"=" + std::to_string(options.aTypeWeights[i]);
+	}
+	return out;
+}
+
+bool WriteStringToFile(const std::filesystem::path& path, const std::string& data) {
+	std::ofstream fout(path, std::ios::out | std::ios::binary);
+	if (!fout.is_open()) return false;
+	fout.write(data.data(), data.length());
+	return true;
+}
+
+struct tBenchmarkResult {
+	std::string name;
+	double minMs = 0;
+	double medianMs = 0;
+};
+std::vector<tBenchmarkResult> aResults;
+int nNumIterations = 5;
+int nNumJobs = 1;
+std::string sFilter;
+std::ostream* pResultsOut = &std::cout; // the tools' own console output is thrown away while they're being measured
+const std::string sReferenceBenchmark = "reference"; // runs whatever the filter, see ReportResults
+
+// setup runs untimed before every iteration, so each one starts from the same state, and check untimed after it to make sure the output is right
+bool RunBenchmark(const std::string& name, const std::function<void()>& setup, const std::function<bool()>& func, const std::function<bool()>& check = nullptr) {
+	if (!sFilter.empty() && name != sReferenceBenchmark && name.find(sFilter) == std::string::npos) return true;
+
+	std::vector<double> times;
+	for (int i = 0; i < nNumIterations; i++) {
+		if (setup) setup();
+		sLastError.clear();
+		auto start = std::chrono::steady_clock::now();
+		bool succeeded = func();
+		auto end = std::chrono::steady_clock::now();
+		if (succeeded && check) succeeded = check();
+		if (!succeeded) {
+			*pResultsOut << "ERROR: " << name << " failed" << (sLastError.empty() ? "" : " (" + sLastError + ")") << std::endl;
+			return false;
+		}
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	aResults.push_back({name, times[0], times[times.size() / 2]});
+	return true;
+}
+
+// "name milliseconds" per line, # starts a comment and "# options ..." records the db the times were measured on
+bool LoadBaseline(const std::string& fileName, std::unordered_map<std::string, double>& out, std::string& outOptions) {
+	std::ifstream fin(fileName);
+	if (!fin.is_open()) return false;
+	for (std::string line; std::getline(fin, line); ) {
+		if (line.starts_with("# options ")) outOptions = line.substr(10);
+		if (line.empty() || line.starts_with('#')) continue;
+		auto split = line.find(' ');
+		if (split == std::string::npos) continue;
+		out[line.substr(0, split)] = std::atof(line.c_str() + split + 1);
+	}
+	return true;
+}
+
+bool SaveBaseline(const std::string& fileName, const std::string& options) {
+	std::string out = "# fastest run of each benchmark in milliseconds, written by FlatOut2DBBenchmark --save-baseline\n";
+	out += "# options " + options + " jobs=" + std::to_string(nNumJobs) + "\n";
+	for (auto& result : aResults) {
+		char line[256];
+		snprintf(line, sizeof(line), "%s %.3f\n", result.name.c_str(), result.minMs);
+		out += line;
+	}
+	return WriteStringToFile(fileName, out);
+}
+
+// these mostly wait on the disk, which changes too much from one run to the next to pass or fail on, so they're only reported
+bool IsDiskBoundBenchmark(const std::string& name) {
+	return name == "load" || name.starts_with("extract") || name.starts_with("repack");
+}
+
+// prints every result next to its baseline, returns false if anything that isn't disk bound got slower by more than tolerance
+// the fastest runs are compared since they're the least affected by whatever else the machine is doing
+// baselines are scaled by how the reference benchmark did against its own, so one saved on another machine still works
+bool ReportResults(const std::unordered_map<std::string, double>& baseline, double tolerance) {
+	bool passed = true;
+	char line[256];
+	double scale = 1;
+	auto reference = baseline.find(sReferenceBenchmark);
+	for (auto& result : aResults) {
+		if (result.name != sReferenceBenchmark || reference == baseline.end() || reference->second <= 0) continue;
+		scale = result.minMs / reference->second;
+		snprintf(line, sizeof(line), "Machine speed %.2fx the baseline's, baselines are scaled to match", 1 / scale);
+		*pResultsOut << line << "\n";
+	}
+	snprintf(line, sizeof(line), "%-16s %10s %10s %10s %8s", "benchmark", "min ms", "median ms", "baseline", "change");
+	*pResultsOut << line << "\n";
+	for (auto& result : aResults) {
+		auto it = baseline.find(result.name);
+		if (it == baseline.end() || it->second <= 0) {
+			snprintf(line, sizeof(line), "%-16s %10.3f %10.3f %10s %8s", result.name.c_str(), result.minMs, result.medianMs, "-", "-");
+			*pResultsOut << line << "\n";
+			continue;
+		}
+		// only what the others are scaled by, it can't regress itself
+		if (result.name == sReferenceBenchmark) {
+			snprintf(line, sizeof(line), "%-16s %10.3f %10.3f %10.3f %8s", result.name.c_str(), result.minMs, result.medianMs, it->second, "-");
+			*pResultsOut << line << "\n";
+			continue;
+		}
+
+		auto change = result.minMs / (it->second * scale) - 1;
+		bool isDiskBound = IsDiskBoundBenchmark(result.name);
+		bool isRegression = !isDiskBound && change > tolerance;
+		if (isRegression) passed = false;
+		snprintf(line, sizeof(line), "%-16s %10.3f %10.3f %10.3f %+7.1f%%%s", result.name.c_str(), result.minMs, result.medianMs, it->second * scale, change * 100, isRegression ? "  REGRESSION" : (isDiskBound ? "  (disk, not checked)" : ""));
+		*pResultsOut << line << "\n";
+	}
+	return passed;
+}
+
+// micro benchmarks for each stage on their own, then every extract and repack path end to end
+bool RunBenchmarks(const std::filesystem::path& workFolder, const tSyntheticDBOptions& options) {
+	auto dbPath = (workFolder / "bench.db").string();
+	auto singleFilePath = (workFolder / "bench.txt").string();
+	auto extractPath = (workFolder / "extract.db").string();
+	auto repackPath = (workFolder / "repack.db").string();
+	auto repackSinglePath = (workFolder / "repack-single.db").string();
+
+	std::string db;
+	if (!GenerateSyntheticDB(options, db)) {
+		*pResultsOut << "ERROR: " << sLastError << std::endl;
+		return false;
+	}
+	if (!WriteStringToFile(dbPath, db) || !WriteStringToFile(extractPath, db)) {
+		*pResultsOut << "ERROR: Failed to write " << dbPath << std::endl;
+		return false;
+	}
+	*pResultsOut << "Generated " << options.numNodes << " nodes, " << db.length() << " bytes (" << GetGeneratorOptionsString(options) << ")" << std::endl;
+
+	// inputs for the maker benchmarks, made with the same code the extractor benchmarks measure
+	extractor::sSingleFileName = singleFilePath;
+	bool prepared = extractor::ParseDB(dbPath, nNumJobs);
+	extractor::sSingleFileName.clear();
+	prepared = prepared && extractor::ParseDB(extractPath, nNumJobs);
+	std::error_code error;
+	std::filesystem::copy(extractPath + " extracted", repackPath + " extracted", std::filesystem::copy_options::recursive, error);
+	if (!prepared || error) {
+		*pResultsOut << "ERROR: Failed to extract " << dbPath << std::endl;
+		return false;
+	}
+
+	tDBFile loadedDB;
+	if (!extractor::LoadDB(loadedDB, dbPath)) return false;
+
+	// the generator's output goes through the maker unchanged, so a repacked db has to match it
+	auto isSameAsLoadedDB = [&](const std::string& name, const char* data, size_t size) {
+		if (size != loadedDB.file.size || memcmp(data, loadedDB.file.data, size) != 0) return ReportError(name + " doesn't match " + dbPath);
+		return true;
+	};
+	// a folder is walked in whatever order the filesystem lists it, so the nodes can end up in a different order
+	auto hasSameContentsAsLoadedDB = [&](const std::string& fileName) {
+		tDBFile db;
+		if (!extractor::LoadDB(db, fileName)) return ReportError("Failed to load " + fileName);
+		extractor::tDBDiff diff;
+		extractor::DiffDB(loadedDB, db, diff);
+		if (diff.numAddedNodes || diff.numRemovedNodes || diff.numChangedNodes) {
+			return ReportError(fileName + " doesn't match " + dbPath + ", " + std::to_string(diff.numAddedNodes) + " nodes added, " + std::to_string(diff.numRemovedNodes) + " removed, " + std::to_string(diff.numChangedNodes) + " changed");
+		}
+		return true;
+	};
+
+	// fixed work that doesn't touch any of the code being measured, only there to tell how fast the machine is right now
+	std::vector<uint32_t> aReferenceData(1 << 20);
+	std::mt19937 random(1);
+	for (auto& value : aReferenceData) {
+		value = random();
+	}
+
+	bool succeeded = true;
+	succeeded &= RunBenchmark(sReferenceBenchmark, nullptr, [&]() {
+		auto data = aReferenceData;
+		std::sort(data.begin(), data.end());
+		return data.front() <= data.back();
+	});
+	succeeded &= RunBenchmark("verify", nullptr, [&]() {
+		return VerifyDB(loadedDB.file.data, loadedDB.file.size);
+	});
+	succeeded &= RunBenchmark("load", nullptr, [&]() {
+		tDBFile db;
+		return extractor::LoadDB(db, dbPath);
+	});
+	succeeded &= RunBenchmark("format", nullptr, [&]() {
+		std::string buffer;
+		for (size_t i = 0; i < loadedDB.nNumNodes; i++) {
+			loadedDB.pRootNode[i].WriteValuesToBuffer(loadedDB, buffer);
+		}
+		return !buffer.empty();
+	});
+	succeeded &= RunBenchmark("parse", nullptr, [&]() {
+		maker::tDBBuilder db;
+		db.dbBaseFolderPath = repackPath + " extracted";
+		return maker::ReadDBSingleFile(db, singleFilePath) && maker::ResolveDBValueNodes(db);
+	});
+	// the library on its own, an opened db copied into a tree and written back out in memory
+	std::vector<char> rewritten;
+	succeeded &= RunBenchmark("rewrite", nullptr, [&]() {
+		tDBTree tree;
+		ReadDBTree(loadedDB, tree);
+		std::vector<char> out;
+		tDBWriteInfo info;
+		if (!WriteDBTree(tree, false, out, info)) return false;
+		rewritten = std::move(out);
+		return true;
+	}, [&]() {
+		return isSameAsLoadedDB("Rewritten db", rewritten.data(), rewritten.size());
+	});
+	// the first value of every node overwritten with itself in place, and a value added to every 64th node so those get rewritten
+	std::vector<tDBValueEdit> patchEdits;
+	for (size_t i = 0; i < loadedDB.nNumNodes; i++) {
+		auto node = &loadedDB.pRootNode[i];
+		if (node->dataCount) {
+			auto value = node->GetValue(loadedDB, 0);
+			auto& edit = patchEdits.emplace_back();
+			edit.nodeId = i;
+			edit.name = value->GetName();
+			edit.type = value->valueType;
+			edit.arrayCount = value->size / value->GetValueTypeSize();
+			edit.data.assign(value->data, value->size);
+		}
+		if (i % 64 == 0) {
+			int data = i;
+			auto& edit = patchEdits.emplace_back();
+			edit.nodeId = i;
+			edit.name = "BenchmarkPatch";
+			edit.type = DBVALUE_INT;
+			edit.arrayCount = 1;
+			edit.data.assign((const char*)&data, sizeof(data));
+		}
+	}
+	succeeded &= RunBenchmark("patch", nullptr, [&]() {
+		std::vector<char> out;
+		tDBPatchInfo info;
+		return PatchDB(loadedDB, patchEdits, out, info) && out.size() > loadedDB.file.size;
+	});
+
+	// writes over the files from the last run, clearing the folder first mostly measures the filesystem
+	succeeded &= RunBenchmark("extract", nullptr, [&]() {
+		return extractor::ParseDB(extractPath, nNumJobs);
+	});
+	succeeded &= RunBenchmark("extract-single", nullptr, [&]() {
+		extractor::sSingleFileName = singleFilePath;
+		bool result = extractor::ParseDB(dbPath, nNumJobs);
+		extractor::sSingleFileName.clear();
+		return result;
+	});
+	succeeded &= RunBenchmark("repack", nullptr, [&]() {
+		return maker::MakeDB(repackPath, nNumJobs);
+	}, [&]() {
+		return hasSameContentsAsLoadedDB(repackPath);
+	});
+	// the single file keeps the nodes in order, so this one has to come out byte for byte the same
+	succeeded &= RunBenchmark("repack-single", nullptr, [&]() {
+		maker::sSingleFileName = singleFilePath;
+		bool result = maker::MakeDB(repackSinglePath, nNumJobs);
+		maker::sSingleFileName.clear();
+		return result;
+	}, [&]() {
+		tDBFile db;
+		if (!extractor::LoadDB(db, repackSinglePath)) return ReportError("Failed to load " + repackSinglePath);
+		return isSameAsLoadedDB(repackSinglePath, db.file.data, db.file.size);
+	});
+	return succeeded;
+}
+
+void PrintUsage() {
+	WriteConsole("Usage: FlatOut2DBBenchmark [generator options] [--iterations N] [--jobs N] [--filter name] [--baseline file] [--save-baseline file] [--tolerance percent] [--work-folder folder]");
+	WriteConsole("       FlatOut2DBBenchmark generate <output> [generator options]");
+	WriteConsole("Generator options: [--nodes N] [--depth N] [--values N] [--array-chance 0-1] [--array-length N] [--node-refs 0-1] [--types int=3,float=3,string=2,...] [--seed N]");
+}
+
+int main(int argc, char *argv[]) {
+	tSyntheticDBOptions options;
+
+	if (argc > 1 && (std::string)argv[1] == "generate") {
+		if (argc < 3) {
+			PrintUsage();
+			return 1;
+		}
+		for (int i = 3; i < argc; i++) {
+			if (!ParseGeneratorOption(argc, argv, i, options)) {
+				PrintUsage();
+				return 1;
+			}
+		}
+		std::string db;
+		if (!GenerateSyntheticDB(options, db)) return 1;
+		if (!WriteStringToFile(argv[2], db)) {
+			WriteConsole("ERROR: Failed to write " + (std::string)argv[2]);
+			return 1;
+		}
+		return 0;
+	}
+
+	std::string baselineFileName, saveBaselineFileName;
+	double tolerance = 0.25;
+	auto workFolder = std::filesystem::temp_directory_path() / "FlatOut2DBBenchmark";
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (ParseGeneratorOption(argc, argv, i, options)) continue;
+		if (arg == "--iterations" && i + 1 < argc) nNumIterations = std::max(1, std::atoi(argv[++i]));
+		else if ((arg == "--jobs" || arg == "-j") && i + 1 < argc) {
+			nNumJobs = std::atoi(argv[++i]);
+			if (nNumJobs <= 0) nNumJobs = std::max(1u, std::thread::hardware_concurrency());
+		}
+		else if (arg == "--filter" && i + 1 < argc) sFilter = argv[++i];
+		else if (arg == "--baseline" && i + 1 < argc) baselineFileName = argv[++i];
+		else if (arg == "--save-baseline" && i + 1 < argc) saveBaselineFileName = argv[++i];
+		else if (arg == "--tolerance" && i + 1 < argc) tolerance = std::atof(argv[++i]) / 100;
+		else if (arg == "--work-folder" && i + 1 < argc) workFolder = argv[++i];
+		else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::unordered_map<std::string, double> baseline;
+	if (!baselineFileName.empty()) {
+		std::string baselineOptions;
+		if (!LoadBaseline(baselineFileName, baseline, baselineOptions)) {
+			WriteConsole("ERROR: Failed to load baseline " + baselineFileName);
+			return 1;
+		}
+		auto currentOptions = GetGeneratorOptionsString(options) + " jobs=" + std::to_string(nNumJobs);
+		if (baselineOptions != currentOptions) {
+			WriteConsole("WARNING: Baseline was measured with " + baselineOptions + ", not " + currentOptions);
+		}
+	}
+
+	// everything in the work folder is deleted afterwards, so it has to start out empty
+	std::error_code error;
+	bool createdWorkFolder = !std::filesystem::exists(workFolder, error);
+	if (!createdWorkFolder && !std::filesystem::is_empty(workFolder, error)) {
+		WriteConsole("ERROR: Work folder " + workFolder.string() + " isn't empty, pick another one or remove what's in it");
+		return 1;
+	}
+	if (!std::filesystem::create_directories(workFolder, error) && error) {
+		WriteConsole("ERROR: Failed to create work folder " + workFolder.string());
+		return 1;
+	}
+
+	std::ostream nullOut(nullptr);
+	pConsoleOut = &nullOut;
+	bool succeeded = RunBenchmarks(workFolder, options);
+	pConsoleOut = &std::cout;
+	if (createdWorkFolder) std::filesystem::remove_all(workFolder, error);
+	else {
+		std::vector<std::filesystem::path> created;
+		for (auto& entry : std::filesystem::directory_iterator(workFolder, error)) {
+			created.push_back(entry.path());
+		}
+		for (auto& path : created) {
+			std::filesystem::remove_all(path, error);
+		}
+	}
+
+	bool passed = ReportResults(baseline, tolerance);
+	if (!saveBaselineFileName.empty() && !SaveBaseline(saveBaselineFileName, GetGeneratorOptionsString(options))) {
+		WriteConsole("ERROR: Failed to write " + saveBaselineFileName);
+		return 1;
+	}
+	return succeeded && passed ? 0 : 1;
+}
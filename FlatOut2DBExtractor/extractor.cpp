@@ -0,0 +1,385 @@
+#include <vector>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include "extractor.h"
+
+namespace extractor {
+
+int nNumJobs = 1;
+std::string sSingleFileName;
+bool bVerify = false;
+
+bool CreateDBNodeFolder(const tDBFile& db, const tDBNode* node, const std::string& outFolder) {
+	if (!node->DoesAnythingDependOnMe(db)) return true;
+
+	auto folderPath = outFolder + "/" + node->GetFullPath(db);
+	std::error_code error;
+	if (std::filesystem::create_directory(folderPath, error)) gStats.nNumDirectoriesCreated++;
+	if (error) return ReportError("Failed to create " + folderPath + " (" + error.message() + ")");
+	return true;
+}
+
+// expects the folder skeleton from CreateDBNodeFolder to already exist
+bool WriteDBNodeFile(const tDBFile& db, const tDBNode* node, const std::string& outFolder) {
+	if (node->dataCount > 0 || !node->DoesAnythingDependOnMe(db)) {
+		// reused for every file written on this thread
+		thread_local std::string buffer;
+		buffer.clear();
+		node->WriteValuesToBuffer(db, buffer);
+
+		auto filePath = outFolder + "/" + node->GetFullPath(db) + ".h";
+		auto outFile = std::ofstream(filePath);
+		outFile.write(buffer.data(), buffer.size());
+		if (!outFile) return ReportError("Failed to write " + filePath);
+		gStats.AddFileWritten(buffer.size());
+	}
+	return true;
+}
+
+// every node in order, each one a "#node <path>" line followed by the contents its .h file would have
+void WriteDBSingleFile(const tDBFile& db, std::ostream& out, int numJobs) {
+	// formatted in parallel a batch at a time, then streamed out in node order
+	const size_t batchSize = 4096;
+	std::vector<std::string> buffers(std::min(db.nNumNodes, batchSize));
+	for (size_t batchStart = 0; batchStart < db.nNumNodes; batchStart += batchSize) {
+		auto batchCount = std::min(batchSize, db.nNumNodes - batchStart);
+		ParallelFor(batchCount, numJobs, [&](size_t i) {
+			auto node = &db.pRootNode[batchStart + i];
+			auto& buffer = buffers[i];
+			buffer = "#node ";
+			buffer += node->GetFullPath(db);
+			buffer += '\n';
+			node->WriteValuesToBuffer(db, buffer);
+		});
+		for (size_t i = 0; i < batchCount; i++) {
+			out.write(buffers[i].data(), buffers[i].size());
+			gStats.nNumBytesWritten += buffers[i].size();
+		}
+	}
+}
+
+// the files are written from several threads
+bool ParseDBData(const tDBFile& db, int numJobs) {
+	auto data = db.pRootNode;
+	auto count = db.nNumNodes;
+
+	WriteConsole("Extracting...");
+	if (!sSingleFileName.empty()) {
+		if (sSingleFileName == "-") {
+			WriteDBSingleFile(db, std::cout, numJobs);
+		}
+		else {
+			auto outFile = std::ofstream(sSingleFileName);
+			if (!outFile.is_open()) return ReportError("Failed to open " + sSingleFileName);
+			WriteDBSingleFile(db, outFile, numJobs);
+			gStats.nNumFilesCreated++;
+		}
+		WriteConsole("Database extracted");
+		return true;
+	}
+
+	auto outFolder = db.fileName + " extracted";
+	std::error_code error;
+	if (std::filesystem::create_directory(outFolder, error)) gStats.nNumDirectoriesCreated++;
+	if (error) return ReportError("Failed to create " + outFolder + " (" + error.message() + ")");
+	for (int i = 0; i < count; i++) {
+		if (!CreateDBNodeFolder(db, &data[i], outFolder)) return false;
+	}
+	// every node writes its own file, so they can be done in any order
+	std::atomic<bool> failed = false;
+	ParallelFor(count, numJobs, [&](size_t i) {
+		if (failed) return;
+		if (!WriteDBNodeFile(db, &data[i], outFolder)) failed = true;
+	});
+	if (failed) return false;
+	WriteConsole("Database extracted");
+	return true;
+}
+
+// prints the value the way it appears in its .h file, or every value in the node if no name is given
+// names are tried as given first, dbs from the maker keep the .h file's spelling in value names
+bool QueryDBValue(const tDBFile& db, const tDBNode* node, std::string_view valueName, std::string& out) {
+	if (!node) return false;
+	if (valueName.empty()) {
+		node->WriteValuesToBuffer(db, out);
+		return true;
+	}
+	auto value = FindNodeValue(db, node, valueName);
+	if (!value) value = FindNodeValue(db, node, GetDBName(valueName));
+	if (!value) return false;
+	value->WriteToFile(db, out);
+	return true;
+}
+
+// "<node path> [value name]" per line, answered from a full path index built once up front
+bool QueryDBBatch(const tDBFile& db, std::istream& in, std::ostream& out) {
+	std::unordered_map<std::string_view, const tDBNode*> nodesByPath;
+	nodesByPath.reserve(db.nNumNodes);
+	for (size_t i = 0; i < db.nNumNodes; i++) {
+		nodesByPath.try_emplace(db.aNodePaths[i], &db.pRootNode[i]);
+	}
+	auto findNode = [&](std::string_view path) -> const tDBNode* {
+		auto it = nodesByPath.find(path);
+		if (it == nodesByPath.end()) it = nodesByPath.find(GetDBName(path));
+		return it != nodesByPath.end() ? it->second : nullptr;
+	};
+
+	bool foundAll = true;
+	std::string buffer;
+	for (std::string line; std::getline(in, line); ) {
+		if (line.ends_with('\r')) line.pop_back();
+		if (line.empty()) continue;
+
+		buffer.clear();
+		// a whole line naming a node, otherwise the last word is the value
+		bool found = QueryDBValue(db, findNode(line), "", buffer);
+		if (!found) {
+			auto split = line.rfind(' ');
+			if (split != std::string::npos) {
+				found = QueryDBValue(db, findNode(std::string_view(line).substr(0, split)), std::string_view(line).substr(split + 1), buffer);
+			}
+		}
+		if (!found) {
+			buffer = "// not found: " + line + "\n";
+			foundAll = false;
+		}
+		out.write(buffer.data(), buffer.size());
+	}
+	return foundAll;
+}
+
+// maps the file and checks the header, everything stays valid for as long as the db stays open
+bool LoadDB(tDBFile& db, const std::string& fileName) {
+	db.fileName = fileName;
+	db.onWarning = [](const std::string& str) { WriteConsole("WARNING: " + str); };
+
+	// the file is never modified, all offsets are resolved on access
+	auto& file = db.file;
+	if (!file.Open(fileName.c_str())) return false;
+	gStats.nNumBytesRead += file.size;
+	if (bVerify && !VerifyDB(file.data, file.size)) return false;
+	if (!OpenDB(db, file.data, file.size)) return false;
+
+	uint64_t aNumValuesByType[256] = {};
+	for (auto value : db.aValues) {
+		aNumValuesByType[value->valueType]++;
+	}
+	for (int i = 0; i < DBVALUE_MAX_COUNT; i++) {
+		gStats.aNumValuesByType[i] += aNumValuesByType[i];
+	}
+	gStats.nNumNodes += db.nNumNodes;
+	return true;
+}
+
+bool ParseDB(const std::string& fileName, int numJobs) {
+	std::error_code error;
+	if (!std::filesystem::exists(fileName, error)) {
+		return ReportError("Failed to load " + std::filesystem::absolute(fileName).string() + "! (File doesn't exist)");
+	}
+
+	tStatsPhaseTimer timer;
+	timer.Start("load");
+	tDBFile db;
+	if (!LoadDB(db, fileName)) {
+		return ReportError("Failed to load binary database " + std::filesystem::absolute(fileName).string() + "!");
+	}
+	timer.Start("extract");
+	return ParseDBData(db, numJobs);
+}
+
+// get <filename> <node path> [value name], or get <filename> - to read queries from stdin
+int QueryDB(int argc, char *argv[]) {
+	pConsoleOut = &std::cerr;
+	if (argc < 4) {
+		WriteConsole("Usage: FlatOut2DBExtractor_gcp.exe get <filename> <node path|-> [value name]");
+		return 1;
+	}
+
+	tDBFile db;
+	if (!LoadDB(db, argv[2])) {
+		WriteConsole("Failed to load binary database " + std::filesystem::absolute(argv[2]).string() + "!");
+		return 1;
+	}
+
+	if ((std::string)argv[3] == "-") {
+		return QueryDBBatch(db, std::cin, std::cout) ? 0 : 1;
+	}
+
+	std::string buffer;
+	auto node = FindNodeByPath(db, argv[3]);
+	if (!node) node = FindNodeByPath(db, GetDBName(argv[3]));
+	if (!QueryDBValue(db, node, argc > 4 ? argv[4] : "", buffer)) {
+		WriteConsole((std::string)"Failed to find " + argv[3] + (argc > 4 ? (std::string)" " + argv[4] : ""));
+		return 1;
+	}
+	std::cout.write(buffer.data(), buffer.size());
+	return 0;
+}
+
+// values are matched by name, node references by the path they point to since ids change whenever nodes are added
+bool IsSameDBValue(const tDBFile& dbA, const tDBValue* a, const tDBFile& dbB, const tDBValue* b) {
+	if (a->valueType != b->valueType || a->arrayType != b->arrayType || a->size != b->size) return false;
+	if (a->valueType != DBVALUE_NODE) return !memcmp(a->data, b->data, a->size);
+	for (int i = 0; i < a->size / 2; i++) {
+		if (dbA.GetFullPathForDBNode(a->GetAsShort(i)) != dbB.GetFullPathForDBNode(b->GetAsShort(i))) return false;
+	}
+	return true;
+}
+
+void AppendDiffLines(std::string& out, const char* prefix, std::string_view lines) {
+	while (!lines.empty()) {
+		auto end = lines.find('\n');
+		if (end == std::string_view::npos) end = lines.length() - 1;
+		out += prefix;
+		out += lines.substr(0, end + 1);
+		lines.remove_prefix(end + 1);
+	}
+	if (!out.ends_with('\n')) out += '\n';
+}
+
+void DiffDBNode(const tDBFile& dbA, const tDBNode* a, const tDBFile& dbB, const tDBNode* b, tDBDiff& diff) {
+	std::string report, patch, line;
+	for (int i = 0; i < b->dataCount; i++) {
+		auto value = b->GetValue(dbB, i);
+		auto oldValue = FindNodeValue(dbA, a, value->GetName());
+		if (oldValue && IsSameDBValue(dbA, oldValue, dbB, value)) continue;
+
+		if (oldValue) {
+			line.clear();
+			oldValue->WriteToFile(dbA, line);
+			AppendDiffLines(report, "\t- ", line);
+		}
+		line.clear();
+		value->WriteToFile(dbB, line);
+		AppendDiffLines(report, "\t+ ", line);
+		patch += line;
+	}
+	for (int i = 0; i < a->dataCount; i++) {
+		auto value = a->GetValue(dbA, i);
+		if (FindNodeValue(dbB, b, value->GetName())) continue;
+
+		line.clear();
+		value->WriteToFile(dbA, line);
+		AppendDiffLines(report, "\t- ", line);
+		patch += "#remove-value ";
+		patch += value->GetName();
+		patch += '\n';
+	}
+	if (patch.empty()) return;
+
+	auto& path = b->GetFullPath(dbB);
+	diff.report += "~ " + path + "\n" + report;
+	diff.patch += "#node " + path + "\n" + patch;
+	diff.numChangedNodes++;
+}
+
+// nodes are matched by their full path through a hash of the first db's paths, so both dbs are only walked once
+void DiffDB(const tDBFile& dbA, const tDBFile& dbB, tDBDiff& diff) {
+	std::unordered_map<std::string_view, size_t> nodeIdsByPath;
+	nodeIdsByPath.reserve(dbA.nNumNodes);
+	for (size_t i = 0; i < dbA.nNumNodes; i++) {
+		nodeIdsByPath.try_emplace(dbA.aNodePaths[i], i);
+	}
+
+	std::vector<uint8_t> matched(dbA.nNumNodes);
+	for (size_t i = 0; i < dbB.nNumNodes; i++) {
+		auto node = &dbB.pRootNode[i];
+		auto& path = dbB.aNodePaths[i];
+		auto it = nodeIdsByPath.find(path);
+		if (it != nodeIdsByPath.end()) {
+			matched[it->second] = true;
+			DiffDBNode(dbA, &dbA.pRootNode[it->second], dbB, node, diff);
+			continue;
+		}
+
+		diff.report += "+ " + path + "\n";
+		diff.patch += "#node " + path + "\n";
+		node->WriteValuesToBuffer(dbB, diff.patch);
+		diff.numAddedNodes++;
+	}
+	for (size_t i = 0; i < dbA.nNumNodes; i++) {
+		if (matched[i]) continue;
+		diff.report += "- " + dbA.aNodePaths[i] + "\n";
+		diff.patch += "#remove-node " + dbA.aNodePaths[i] + "\n";
+		diff.numRemovedNodes++;
+	}
+}
+
+// diff <a> <b> [--patch <output|->], exits with 1 if the dbs are different like diff does
+int DiffDBFiles(int argc, char *argv[]) {
+	pConsoleOut = &std::cerr;
+	std::vector<std::string> aFileNames;
+	std::string patchFileName;
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--patch" && i + 1 < argc) patchFileName = argv[++i];
+		else aFileNames.push_back(arg);
+	}
+	if (aFileNames.size() != 2) {
+		WriteConsole("Usage: FlatOut2DBExtractor_gcp.exe diff <filename> <filename> [--patch <output|->]");
+		return 2;
+	}
+
+	tDBFile dbA, dbB;
+	for (auto db : {&dbA, &dbB}) {
+		auto& fileName = aFileNames[db == &dbA ? 0 : 1];
+		if (!LoadDB(*db, fileName)) {
+			WriteConsole("Failed to load binary database " + std::filesystem::absolute(fileName).string() + "!");
+			return 2;
+		}
+	}
+
+	tDBDiff diff;
+	DiffDB(dbA, dbB, diff);
+
+	if (patchFileName == "-") {
+		std::cout.write(diff.patch.data(), diff.patch.size());
+	}
+	else {
+		if (!patchFileName.empty()) {
+			std::ofstream fout(patchFileName, std::ios::out | std::ios::binary);
+			if (!fout.is_open()) {
+				WriteConsole("Failed to open " + patchFileName + "!");
+				return 2;
+			}
+			fout.write(diff.patch.data(), diff.patch.size());
+		}
+		std::cout.write(diff.report.data(), diff.report.size());
+	}
+
+	bool isSame = !diff.numAddedNodes && !diff.numRemovedNodes && !diff.numChangedNodes;
+	if (isSame) WriteConsole("No differences");
+	else WriteConsole(std::to_string(diff.numAddedNodes) + " nodes added, " + std::to_string(diff.numRemovedNodes) + " removed, " + std::to_string(diff.numChangedNodes) + " changed");
+	return isSame ? 0 : 1;
+}
+
+// verify [--jobs N] <filename|pattern|@list>..., only checks the files without extracting anything
+int VerifyDBFiles(int argc, char *argv[]) {
+	std::vector<std::string> aFileNames;
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		if ((arg == "--jobs" || arg == "-j") && i + 1 < argc) {
+			nNumJobs = std::atoi(argv[++i]);
+			if (nNumJobs <= 0) nNumJobs = std::max(1u, std::thread::hardware_concurrency());
+		}
+		else ExpandDBFileArgument(arg, "", aFileNames);
+	}
+	if (aFileNames.empty()) {
+		WriteConsole("Usage: FlatOut2DBExtractor_gcp.exe verify [--jobs N] <filename|pattern|@list>...");
+		return 0;
+	}
+
+	bool succeeded = ProcessDBFiles(aFileNames, nNumJobs, [&](const std::string& fileName) {
+		tMappedFile file;
+		if (!file.Open(fileName.c_str())) {
+			return ReportError("Failed to load " + std::filesystem::absolute(fileName).string() + "!");
+		}
+		if (!VerifyDB(file.data, file.size)) return false;
+		if (aFileNames.size() == 1) WriteConsole(fileName + " is valid");
+		return true;
+	});
+	return succeeded ? 0 : 1;
+}
+
+}
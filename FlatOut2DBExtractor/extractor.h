@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../shared.h"
+
+// everything the extractor does apart from reading its command line, also built into the benchmark
+namespace extractor {
+
+extern int nNumJobs;
+extern std::string sSingleFileName; // write everything into this file instead of a folder, - for stdout
+extern bool bVerify; // run VerifyDB on every db before anything else reads it
+
+bool LoadDB(tDBFile& db, const std::string& fileName);
+bool ParseDB(const std::string& fileName, int numJobs);
+
+// everything that changed from one db to another, as a report and as a patch in the --single-file syntax
+// the patch has a "#node <path>" section with the new values for every added or changed node,
+// "#remove-value <name>" lines for values that are gone from it and a "#remove-node <path>" line for every removed node
+struct tDBDiff {
+	std::string report;
+	std::string patch;
+	size_t numAddedNodes = 0;
+	size_t numRemovedNodes = 0;
+	size_t numChangedNodes = 0;
+};
+
+// nodes are matched by path, so the two dbs can have them in any order
+void DiffDB(const tDBFile& dbA, const tDBFile& dbB, tDBDiff& diff);
+
+// the get, diff and verify modes, each one takes the whole command line
+int QueryDB(int argc, char *argv[]);
+int DiffDBFiles(int argc, char *argv[]);
+int VerifyDBFiles(int argc, char *argv[]);
+
+}
@@ -0,0 +1,1032 @@
+#include <vector>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <cstdio>
+#include <unordered_map>
+#include "maker.h"
+
+namespace maker {
+
+int nNumJobs = 1;
+std::string sSingleFileName;
+
+// splits a file that's already in memory into lines without copying them
+struct tLineReader {
+	std::string_view buffer;
+	size_t position = 0;
+
+	bool GetLine(std::string_view& outLine) {
+		if (position >= buffer.length()) return false;
+		auto end = buffer.find('\n', position);
+		if (end == std::string_view::npos) end = buffer.length();
+		outLine = buffer.substr(position, end - position);
+		if (outLine.ends_with('\r')) outLine.remove_suffix(1);
+		position = end + 1;
+		return true;
+	}
+};
+
+bool ReadFileToString(const std::filesystem::path& path, std::string& out) {
+	std::ifstream fin(path, std::ios::in | std::ios::binary);
+	if (!fin.is_open()) return false;
+
+	fin.seekg(0, std::ios::end);
+	out.resize(fin.tellg());
+	fin.seekg(0, std::ios::beg);
+	fin.read(out.data(), out.length());
+	gStats.nNumBytesRead += out.length();
+	return true;
+}
+
+// written next to the file and renamed over it, so a failed write never leaves a truncated file behind
+bool WriteFileReplacing(const std::string& fileName, const char* data, size_t size) {
+	auto tmpFileName = fileName + ".tmp";
+	std::ofstream fout(tmpFileName, std::ios::out | std::ios::binary);
+	if (!fout.is_open()) return ReportError("Failed to open " + tmpFileName + " for writing");
+	fout.write(data, size);
+	fout.close();
+	std::error_code error;
+	if (!fout) {
+		std::filesystem::remove(tmpFileName, error);
+		return ReportError("Failed to write to " + tmpFileName);
+	}
+	std::filesystem::rename(tmpFileName, fileName, error);
+	if (error) {
+		auto message = error.message();
+		std::filesystem::remove(tmpFileName, error);
+		return ReportError("Failed to replace " + fileName + " (" + message + ")");
+	}
+	gStats.AddFileWritten(size);
+	return true;
+}
+
+// same leniency as std::stoi/std::stof, without allocating or throwing
+template<typename T>
+bool ParseDBNumber(std::string_view string, T& out) {
+	while (string.starts_with(' ') || string.starts_with('\t')) string.remove_prefix(1);
+	if (string.starts_with('+')) string.remove_prefix(1);
+	auto result = std::from_chars(string.data(), string.data() + string.length(), out);
+	return result.ec == std::errc();
+}
+
+bool GetDBValueNodePath(tDBBuilder& db, std::string_view string, std::string_view& outPath) {
+	auto orig = string;
+	if (!string.starts_with('"')) {
+		return ReportError("Invalid format for line " + (std::string)orig);
+	}
+	string.remove_prefix(1);
+	if (string.ends_with('"')) {
+		string.remove_suffix(1);
+	}
+	else if (string.ends_with("\",")) {
+		string.remove_suffix(2);
+	}
+	else {
+		return ReportError("Invalid format for line " + (std::string)orig);
+	}
+	outPath = db.valueArena.Copy(string);
+	return true;
+}
+
+tDBNodeTemp* GetDBValueNodePtr(tDBBuilder& db, std::string_view path) {
+	auto pNode = GetNodeForPath(db, db.dbBaseFolderPath.string() + "/" + (std::string)path, false);
+	if (!pNode) {
+		WriteConsole("ERROR: Failed to find node " + db.dbBaseFolderPath.string() + "/" + (std::string)path);
+		return nullptr;
+	}
+	return pNode;
+}
+
+template<typename T>
+bool GetDBValueVector(std::string_view string, T* data, int valueCount) {
+	string.remove_prefix(2);
+
+	for (int i = 0; i < valueCount; i++) {
+		float value;
+		if (!ParseDBNumber(string, value)) return false;
+		data[i] = value;
+
+		// find next value
+		if (i + 1 < valueCount) {
+			auto next = string.find(", ");
+			if (next == std::string_view::npos) return false;
+			string.remove_prefix(next + 2);
+		}
+	}
+	return true;
+}
+
+bool ReadSingleDBValue(tDBBuilder& db, tDBValueTemp* value, int type, std::string_view string) {
+	switch (type) {
+		case DBVALUE_INT: {
+			value->data = db.valueArena.Allocate<int>();
+			if (!ParseDBNumber(string, *(int*)value->data)) return false;
+		} break;
+		case DBVALUE_FLOAT: {
+			value->data = db.valueArena.Allocate<float>();
+			if (!ParseDBNumber(string, *(float*)value->data)) return false;
+		} break;
+		case DBVALUE_BOOL: {
+			value->data = db.valueArena.Allocate<uint32_t>();
+			*(uint32_t *) value->data = string.starts_with("true");
+		} break;
+		case DBVALUE_NODE: {
+			value->nodePaths.emplace_back();
+			if (!GetDBValueNodePath(db, string, value->nodePaths.back())) return false;
+		} break;
+		case DBVALUE_VECTOR2:
+		case DBVALUE_VECTOR3:
+		case DBVALUE_VECTOR4: {
+			if (!string.starts_with("{ ")) {
+				return ReportError("Failed to find vector in " + (std::string)string);
+			}
+
+			int valueCount = (type - DBVALUE_VECTOR2) + 2;
+			value->data = db.valueArena.Allocate<float>(valueCount);
+			if (!GetDBValueVector<float>(string, (float*)value->data, valueCount)) {
+				return ReportError("Failed to parse vector in " + (std::string)string);
+			}
+		} break;
+		case DBVALUE_RGBA: {
+			if (!string.starts_with("{ ")) {
+				return ReportError("Failed to find vector in " + (std::string)string);
+			}
+
+			int valueCount = 4;
+			value->data = db.valueArena.Allocate<uint8_t>(valueCount);
+			if (!GetDBValueVector<uint8_t>(string, (uint8_t*)value->data, valueCount)) {
+				return ReportError("Failed to parse vector in " + (std::string)string);
+			}
+		} break;
+		default: {
+			return ReportError("type not implemented: " + std::to_string(type));
+		}
+	}
+	return true;
+}
+
+bool ReadDBArrayNextLine(tLineReader& file, std::string_view& outString) {
+	if (!file.GetLine(outString)) return false;
+	if (outString.ends_with("};")) return false;
+	while (outString.starts_with('\t')) {
+		outString.remove_prefix(1);
+	}
+	return true;
+}
+
+// number of entries in the array starting at the reader's position, without moving the reader
+int CountDBArrayLines(tLineReader file) {
+	int count = 0;
+	std::string_view string;
+	while (ReadDBArrayNextLine(file, string)) {
+		count++;
+	}
+	return count;
+}
+
+bool ReadDBArrayValue(tDBBuilder& db, tDBValueTemp* value, int type, tLineReader& file, std::string_view string) {
+	if (!string.ends_with('{')) {
+		return false;
+	}
+
+	// the entries are counted first so they can be parsed straight into their final storage
+	int count = CountDBArrayLines(file);
+	value->arrayCount = count;
+
+	switch (type) {
+		case DBVALUE_CHAR: {
+			auto arr = db.valueArena.Allocate<uint8_t>(count);
+			value->data = arr;
+
+			for (int j = 0; ReadDBArrayNextLine(file, string); j++) {
+				int number;
+				if (!ParseDBNumber(string, number)) return false;
+				arr[j] = number;
+			}
+		} break;
+		case DBVALUE_INT: {
+			auto arr = db.valueArena.Allocate<int>(count);
+			value->data = arr;
+
+			for (int j = 0; ReadDBArrayNextLine(file, string); j++) {
+				if (!ParseDBNumber(string, arr[j])) return false;
+			}
+		} break;
+		case DBVALUE_FLOAT: {
+			auto arr = db.valueArena.Allocate<float>(count);
+			value->data = arr;
+
+			for (int j = 0; ReadDBArrayNextLine(file, string); j++) {
+				if (!ParseDBNumber(string, arr[j])) return false;
+			}
+		} break;
+		case DBVALUE_NODE: {
+			auto& values = value->nodePaths;
+			values.reserve(count);
+
+			while (ReadDBArrayNextLine(file, string)) {
+				if (!GetDBValueNodePath(db, string, values.emplace_back())) {
+					return ReportError("Failed to parse node array in " + value->name);
+				}
+			}
+		} break;
+		case DBVALUE_VECTOR2:
+		case DBVALUE_VECTOR3:
+		case DBVALUE_VECTOR4: {
+			int valueCount = (type - DBVALUE_VECTOR2) + 2;
+
+			auto arr = db.valueArena.Allocate<float>(count * valueCount);
+			value->data = arr;
+
+			for (int j = 0; ReadDBArrayNextLine(file, string); j++) {
+				if (!string.starts_with("{ ")) {
+					return ReportError("Failed to find vector in " + (std::string)string);
+				}
+
+				if (!GetDBValueVector<float>(string, &arr[j * valueCount], valueCount)) {
+					return ReportError("Failed to parse vector in " + (std::string)string);
+				}
+			}
+		} break;
+		default: {
+			return ReportError("arrays not implemented yet for type " + std::to_string(type));
+		}
+	}
+	return true;
+}
+
+bool ParseDBLine(tDBBuilder& db, tDBNodeTemp* node, std::string_view line, tLineReader& file) {
+	if (line.length() < 3) return true;
+	auto tmp = line;
+	while (tmp.starts_with('\t')) tmp.remove_prefix(1);
+	if (tmp.starts_with("//")) return true;
+
+	for (int i = 0; i < DBVALUE_MAX_COUNT; i++) {
+		auto typeName = aValueTypeNames[i];
+		if (!typeName) continue;
+		if (!tmp.starts_with(typeName)) continue;
+
+		tDBValueTemp value;
+		value.type = i;
+
+		tmp.remove_prefix(strlen(typeName));
+		if (tmp.starts_with('*') && i == DBVALUE_STRING) tmp.remove_prefix(1);
+		if (!tmp.starts_with(' ')) {
+			return ReportError("Failed to read line " + (std::string)line + " for node " + node->name);
+		}
+		tmp.remove_prefix(1);
+
+		auto arrayBegin = tmp.find('[');
+		auto valueStringLength = tmp.find(" = ");
+		auto lengthToValue = valueStringLength + 3;
+		if (valueStringLength == std::string_view::npos || valueStringLength < 1 || (arrayBegin != std::string_view::npos && arrayBegin > valueStringLength)) {
+			return ReportError("Failed to read variable name " + (std::string)line + " for node " + node->name);
+		}
+
+		// todo - add fixed size string support
+		//if (tmp[arrayBegin+1] != ']') {
+		//
+		//}
+
+		bool isArray = arrayBegin != std::string_view::npos;
+		if (isArray) valueStringLength = arrayBegin;
+		else if (!tmp.ends_with(';')) {
+			return ReportError("Failed to find line ending " + (std::string)line + " for node " + node->name);
+		}
+		else {
+			// remove trailing semicolon
+			tmp.remove_suffix(1);
+		}
+
+		// copy name string in
+		value.name = tmp.substr(0, valueStringLength);
+
+		tmp.remove_prefix(lengthToValue);
+
+		if (i == DBVALUE_STRING) {
+			if (!tmp.starts_with('"')) {
+				return ReportError("Failed to read string " + (std::string)line + " for node " + node->name);
+			}
+			tmp.remove_prefix(1);
+			auto stringLength = tmp.find('"');
+			if (stringLength == std::string_view::npos) {
+				return ReportError("Failed to read end of string " + (std::string)line + " for node " + node->name);
+			}
+
+			value.data = db.valueArena.Allocate<char>(stringLength + 1);
+			memcpy(value.data, tmp.data(), stringLength);
+			((char*)value.data)[stringLength] = 0;
+			value.arrayCount = stringLength + 1;
+		}
+		else {
+			if (isArray) {
+				if (!ReadDBArrayValue(db, &value, i, file, tmp)) {
+					return ReportError("Parsing failed on line " + (std::string)line);
+				}
+			}
+			else {
+				value.arrayCount = 1;
+				if (!ReadSingleDBValue(db, &value, i, tmp)) {
+					return ReportError("Parsing failed on line " + (std::string)line);
+				}
+			}
+		}
+
+		node->values.push_back(value);
+		return true;
+	}
+
+	return ReportError("Failed to find a typename in " + (std::string)line + " for node " + node->name);
+}
+
+template<typename T>
+void WriteBinary(std::string& out, const T& value) {
+	out.append((const char*)&value, sizeof(T));
+}
+
+void WriteBinaryString(std::string& out, std::string_view string) {
+	WriteBinary<uint32_t>(out, string.length());
+	out += string;
+}
+
+// bounds checked reads from a buffer written with WriteBinary
+struct tBinaryReader {
+	std::string_view buffer;
+
+	template<typename T>
+	bool Read(T& out) {
+		if (buffer.length() < sizeof(T)) return false;
+		memcpy(&out, buffer.data(), sizeof(T));
+		buffer.remove_prefix(sizeof(T));
+		return true;
+	}
+
+	bool ReadBytes(size_t size, std::string_view& out) {
+		if (buffer.length() < size) return false;
+		out = buffer.substr(0, size);
+		buffer.remove_prefix(size);
+		return true;
+	}
+
+	bool ReadString(std::string_view& out) {
+		uint32_t length;
+		return Read(length) && ReadBytes(length, out);
+	}
+};
+
+// compact binary form of a node's parsed values, node references are kept as unresolved paths
+void WriteDBValueRecords(const std::vector<tDBValueTemp>& values, std::string& out) {
+	WriteBinary<uint32_t>(out, values.size());
+	for (auto& value : values) {
+		WriteBinaryString(out, value.name);
+		WriteBinary<uint8_t>(out, value.type);
+		WriteBinary<uint32_t>(out, value.arrayCount);
+		if (value.type == DBVALUE_NODE) {
+			WriteBinary<uint32_t>(out, value.nodePaths.size());
+			for (auto& path : value.nodePaths) {
+				WriteBinaryString(out, path);
+			}
+		}
+		else {
+			out.append((const char*)value.data, value.arrayCount * GetDBValueTypeSize(value.type));
+		}
+	}
+}
+
+bool ReadDBValueRecords(tDBBuilder& db, std::string_view records, std::vector<tDBValueTemp>& out) {
+	tBinaryReader reader = {records};
+	uint32_t count;
+	if (!reader.Read(count)) return false;
+	for (uint32_t i = 0; i < count; i++) {
+		auto& value = out.emplace_back();
+		std::string_view name;
+		uint8_t type;
+		uint32_t arrayCount;
+		if (!reader.ReadString(name) || !reader.Read(type) || !reader.Read(arrayCount)) return false;
+		value.name = name;
+		value.type = type;
+		value.arrayCount = arrayCount;
+
+		if (type == DBVALUE_NODE) {
+			uint32_t numPaths;
+			if (!reader.Read(numPaths)) return false;
+			for (uint32_t j = 0; j < numPaths; j++) {
+				std::string_view path;
+				if (!reader.ReadString(path)) return false;
+				value.nodePaths.push_back(db.valueArena.Copy(path));
+			}
+		}
+		else {
+			std::string_view data;
+			if (!reader.ReadBytes(arrayCount * GetDBValueTypeSize(type), data)) return false;
+			value.data = db.valueArena.Allocate(data.length(), 8);
+			memcpy(value.data, data.data(), data.length());
+		}
+	}
+	return reader.buffer.empty();
+}
+
+bool bIncremental = false;
+bool bInternStrings = false;
+
+const uint32_t nManifestIdentifier = 0x4D324F46; // FO2M
+const uint32_t nManifestVersion = 1;
+
+bool LoadDBManifest(tDBBuilder& db, const std::string& fileName) {
+	db.mManifest.clear();
+	if (!ReadFileToString(fileName, db.sManifestBuffer)) return false;
+
+	tBinaryReader reader = {db.sManifestBuffer};
+	uint32_t identifier, version, count;
+	if (!reader.Read(identifier) || !reader.Read(version) || !reader.Read(count)) return false;
+	if (identifier != nManifestIdentifier || version != nManifestVersion) return false;
+	for (uint32_t i = 0; i < count; i++) {
+		std::string_view path;
+		tManifestEntry entry;
+		if (!reader.ReadString(path) || !reader.Read(entry.size) || !reader.Read(entry.writeTime) || !reader.Read(entry.hash) || !reader.ReadString(entry.values)) {
+			db.mManifest.clear();
+			return false;
+		}
+		db.mManifest[(std::string)path] = entry;
+	}
+	return true;
+}
+
+// parsed values shared between every build on the machine, keyed by the hash and size of the file they came from
+std::filesystem::path sCacheFolder;
+uint64_t nCacheSizeLimit = 256ull * 1024 * 1024;
+
+const uint32_t nCacheIdentifier = 0x43324F46; // FO2C
+const uint32_t nCacheVersion = 2;
+
+std::filesystem::path GetCacheEntryPath(uint64_t hash, uint64_t size) {
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx-%llx.fo2c", (unsigned long long)hash, (unsigned long long)size);
+	return sCacheFolder / name;
+}
+
+// anything missing, half written or mismatched is just treated as a miss
+// the name only has the first hash, checkHash is compared too so two files colliding in it can't be mixed up
+bool ReadCacheEntry(tDBBuilder& db, uint64_t hash, uint64_t checkHash, uint64_t size, std::vector<tDBValueTemp>& out) {
+	thread_local std::string buffer;
+	auto path = GetCacheEntryPath(hash, size);
+	if (!ReadFileToString(path, buffer)) return false;
+
+	tBinaryReader reader = {buffer};
+	uint32_t identifier, version;
+	uint64_t entryHash, entryCheckHash, entrySize;
+	if (!reader.Read(identifier) || !reader.Read(version) || !reader.Read(entryHash) || !reader.Read(entryCheckHash) || !reader.Read(entrySize)) return false;
+	if (identifier != nCacheIdentifier || version != nCacheVersion || entryHash != hash || entryCheckHash != checkHash || entrySize != size) return false;
+	if (!ReadDBValueRecords(db, reader.buffer, out)) {
+		out.clear();
+		return false;
+	}
+
+	// bump it so it's the last to go when the cache is trimmed
+	std::error_code error;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	return true;
+}
+
+// written under a unique name and renamed into place, so other processes never see a partial entry
+void WriteCacheEntry(uint64_t hash, uint64_t checkHash, uint64_t size, const std::string& records) {
+	std::string out;
+	WriteBinary(out, nCacheIdentifier);
+	WriteBinary(out, nCacheVersion);
+	WriteBinary(out, hash);
+	WriteBinary(out, checkHash);
+	WriteBinary(out, size);
+	out += records;
+
+	auto path = GetCacheEntryPath(hash, size);
+	thread_local std::mt19937_64 random(std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+	auto tmpPath = path;
+	tmpPath += "." + std::to_string(random()) + ".tmp";
+	{
+		std::ofstream fout(tmpPath, std::ios::out | std::ios::binary);
+		if (!fout.is_open()) return;
+		fout.write(out.data(), out.length());
+		if (!fout) {
+			fout.close();
+			std::error_code error;
+			std::filesystem::remove(tmpPath, error);
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tmpPath, path, error);
+	if (error) std::filesystem::remove(tmpPath, error);
+	else gStats.AddFileWritten(out.length());
+}
+
+// drops the least recently used entries until the cache is back under its limit
+// temporary files left behind by a maker that was killed mid-write are dropped once they're old enough that nobody is still writing them
+void TrimCache() {
+	const auto staleTempAge = std::chrono::hours(1);
+
+	struct tCacheFile {
+		std::filesystem::path path;
+		uint64_t size;
+		std::filesystem::file_time_type writeTime;
+	};
+	std::vector<tCacheFile> files;
+	std::vector<std::filesystem::path> staleTempFiles;
+	uint64_t totalSize = 0;
+
+	auto now = std::filesystem::file_time_type::clock::now();
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(sCacheFolder, error)) {
+		auto extension = entry.path().extension();
+		if (extension != ".fo2c" && extension != ".tmp") continue;
+		std::error_code fileError;
+		auto size = entry.file_size(fileError);
+		auto writeTime = entry.last_write_time(fileError);
+		if (fileError) continue;
+		if (extension == ".tmp") {
+			if (now - writeTime > staleTempAge) staleTempFiles.push_back(entry.path());
+			continue;
+		}
+		files.push_back({entry.path(), size, writeTime});
+		totalSize += size;
+	}
+	for (auto& path : staleTempFiles) {
+		std::filesystem::remove(path, error);
+	}
+	if (totalSize <= nCacheSizeLimit) return;
+
+	std::sort(files.begin(), files.end(), [](const tCacheFile& a, const tCacheFile& b) { return a.writeTime < b.writeTime; });
+	for (auto& file : files) {
+		if (totalSize <= nCacheSizeLimit) break;
+		// another process may have removed it already, or still have it open
+		if (std::filesystem::remove(file.path, error)) totalSize -= file.size;
+	}
+}
+
+bool ParseDBNode(tDBBuilder& db, const std::filesystem::directory_entry& at) {
+	const auto& path = at.path();
+	std::error_code error;
+	bool isDirectory = at.is_directory(error);
+	if (error) return ReportError("Failed to read " + path.string() + " (" + error.message() + ")");
+	auto pathWithoutExtension = path;
+	if (!isDirectory) pathWithoutExtension.replace_extension("");
+
+	bool isRootNode = path.filename() == "root";
+	if (!db.hasRootNode && isRootNode) db.hasRootNode = true;
+	else {
+		if (!db.hasRootNode && !isRootNode) {
+			return ReportError("Root node not found, found " + path.filename().string() + " first");
+		}
+		if (db.hasRootNode && isRootNode) {
+			return ReportError("Root node found where it shouldn't be");
+		}
+	}
+
+	if (isRootNode) {
+		auto node = GetNodeForPath(db, pathWithoutExtension, true);
+		node->parentNodeId = 0;
+	}
+	else {
+		GenerateNodesToGetToRoot(db, pathWithoutExtension);
+
+		auto node = GetNodeForPath(db, pathWithoutExtension, true);
+		while (node != &db.aNodes[node->parentNodeId]) {
+			node = &db.aNodes[node->parentNodeId];
+		}
+	}
+
+	if (isDirectory) {
+		for (std::filesystem::directory_iterator it(path, error), end; !error && it != end; it.increment(error)) {
+			if (!ParseDBNode(db, *it)) return false;
+		}
+		if (error) return ReportError("Failed to read " + path.string() + " (" + error.message() + ")");
+	}
+	else if (path.extension() == ".h") {
+		auto node = GetNodeForPath(db, pathWithoutExtension, false);
+		if (!node) {
+			return ReportError("Failed to find node " + pathWithoutExtension.string());
+		}
+		db.aNodeFiles.push_back({(int)(node - &db.aNodes[0]), path});
+	}
+	return true;
+}
+
+// every file fills in a different node and nothing is looked up by path, so they can be parsed in any order
+bool ParseDBNodeFiles(tDBBuilder& db) {
+	std::atomic<bool> failed = false;
+	ParallelFor(db.aNodeFiles.size(), db.nNumJobs, [&](size_t i) {
+		if (failed) return;
+
+		auto& file = db.aNodeFiles[i];
+		auto node = &db.aNodes[file.nodeId];
+
+		const tManifestEntry* lastEntry = nullptr;
+		auto reuseLastEntry = [&]() {
+			if (!ReadDBValueRecords(db, lastEntry->values, node->values)) {
+				node->values.clear();
+				return false;
+			}
+			file.values = lastEntry->values;
+			db.nNumReusedFiles++;
+			return true;
+		};
+
+		if (bIncremental) {
+			file.manifestPath = file.path.lexically_relative(db.dbBaseFolderPath).generic_string();
+			std::error_code error;
+			file.manifestEntry.size = std::filesystem::file_size(file.path, error);
+			file.manifestEntry.writeTime = std::filesystem::last_write_time(file.path, error).time_since_epoch().count();
+
+			auto it = db.mManifest.find(file.manifestPath);
+			if (it != db.mManifest.end()) lastEntry = &it->second;
+
+			// untouched since the last run, no need to even read it
+			if (lastEntry && lastEntry->size == file.manifestEntry.size && lastEntry->writeTime == file.manifestEntry.writeTime) {
+				file.manifestEntry.hash = lastEntry->hash;
+				if (reuseLastEntry()) return;
+			}
+		}
+
+		// reused for every file parsed on this thread
+		thread_local std::string buffer;
+		if (!ReadFileToString(file.path, buffer)) return;
+
+		uint64_t hash = 0;
+		if (bIncremental || !sCacheFolder.empty()) hash = GetContentHash(buffer.data(), buffer.length());
+
+		if (bIncremental) {
+			// saved again with different timestamps, but the same contents
+			file.manifestEntry.hash = hash;
+			if (lastEntry && lastEntry->hash == file.manifestEntry.hash && reuseLastEntry()) return;
+		}
+
+		uint64_t checkHash = 0;
+		if (!sCacheFolder.empty()) checkHash = GetContentCheckHash(buffer.data(), buffer.length());
+		if (!sCacheFolder.empty() && ReadCacheEntry(db, hash, checkHash, buffer.length(), node->values)) {
+			if (bIncremental) WriteDBValueRecords(node->values, file.values);
+			db.nNumCacheHits++;
+			return;
+		}
+
+		tLineReader reader = {buffer};
+		for (std::string_view line; reader.GetLine(line); ) {
+			if (!ParseDBLine(db, node, line, reader)) {
+				failed = true;
+				return;
+			}
+		}
+
+		if (bIncremental || !sCacheFolder.empty()) {
+			std::string records;
+			WriteDBValueRecords(node->values, records);
+			if (!sCacheFolder.empty()) WriteCacheEntry(hash, checkHash, buffer.length(), records);
+			if (bIncremental) file.values = std::move(records);
+		}
+	});
+	return !failed;
+}
+
+// only lists the files from this run, so removed files drop out
+bool SaveDBManifest(const tDBBuilder& db, const std::string& fileName) {
+	std::string out;
+	WriteBinary(out, nManifestIdentifier);
+	WriteBinary(out, nManifestVersion);
+	WriteBinary<uint32_t>(out, db.aNodeFiles.size());
+	for (auto& file : db.aNodeFiles) {
+		WriteBinaryString(out, file.manifestPath);
+		WriteBinary(out, file.manifestEntry.size);
+		WriteBinary(out, file.manifestEntry.writeTime);
+		WriteBinary(out, file.manifestEntry.hash);
+		WriteBinaryString(out, file.values);
+	}
+	return WriteFileReplacing(fileName, out.data(), out.length());
+}
+
+// node references are only stored as paths while parsing, this looks them all up once every node exists
+bool ResolveDBValueNodes(tDBBuilder& db) {
+	for (auto& node : db.aNodes) {
+		for (auto& value : node.values) {
+			if (value.type != DBVALUE_NODE) continue;
+
+			auto arr = db.valueArena.Allocate<uint16_t>(value.nodePaths.size());
+			for (int j = 0; j < value.nodePaths.size(); j++) {
+				auto node = GetDBValueNodePtr(db, value.nodePaths[j]);
+				if (!node && value.arrayCount > 1) {
+					return ReportError("Failed to parse node array in " + value.name);
+				}
+				if (node && node - &db.aNodes[0] >= UINT16_MAX) {
+					return ReportError("Node reference " + (std::string)value.nodePaths[j] + " in " + value.name + " is past the " + std::to_string(UINT16_MAX) + " nodes a reference can reach");
+				}
+				arr[j] = node ? node - &db.aNodes[0] : UINT16_MAX; // left pointing nowhere, verify catches it
+			}
+			value.data = arr;
+		}
+	}
+	return true;
+}
+
+// "#node <path>" lines start each node, everything up to the next one is that node's .h contents
+bool ReadDBSingleFile(tDBBuilder& db, const std::string& fileName) {
+	// one read from disk, both passes run over the copy in memory
+	std::string buffer;
+	if (!ReadFileToString(fileName, buffer)) return false;
+
+	// read the structure first, then read data
+	for (int pass = 0; pass < 2; pass++) {
+		bool readFiles = pass == 1;
+		tLineReader file = {buffer};
+
+		tDBNodeTemp* node = nullptr;
+		for (std::string_view line; file.GetLine(line); ) {
+			if (line.starts_with("#node ")) {
+				auto name = (std::string)line.substr(6);
+				std::filesystem::path path = db.dbBaseFolderPath.string() + "/" + name;
+				if (readFiles) {
+					node = GetNodeForPath(db, path, false);
+				}
+				else if (db.aNodes.empty()) {
+					if (name != "root") {
+						return ReportError("Root node not found, found " + name + " first");
+					}
+					GetNodeForPath(db, path, true)->parentNodeId = 0;
+				}
+				else {
+					if (name == "root") {
+						return ReportError("Root node found where it shouldn't be");
+					}
+					GenerateNodesToGetToRoot(db, path);
+				}
+			}
+			else if (readFiles) {
+				if (!node) {
+					if (line.length() < 3 || line.starts_with("//")) continue;
+					return ReportError("Found data before the first node in " + fileName);
+				}
+				if (!ParseDBLine(db, node, line, file)) return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool WriteDB(tDBBuilder& db) {
+	auto& fileName = db.fileName;
+	db.dbBaseFolderPath = fileName + " extracted";
+	std::error_code error;
+	if (sSingleFileName.empty() && !std::filesystem::is_directory(db.dbBaseFolderPath, error)) return false;
+
+	tStatsPhaseTimer timer;
+	timer.Start("read");
+	WriteConsole("Reading...");
+
+	if (!sSingleFileName.empty()) {
+		if (!ReadDBSingleFile(db, sSingleFileName)) return false;
+	}
+	else {
+		// one walk for the structure, the files are read after it so node references can point anywhere
+		for (std::filesystem::directory_iterator it(db.dbBaseFolderPath, error), end; !error && it != end; it.increment(error)) {
+			if (!ParseDBNode(db, *it)) return false;
+		}
+		if (error) return ReportError("Failed to read " + db.dbBaseFolderPath.string() + " (" + error.message() + ")");
+		if (bIncremental && !LoadDBManifest(db, fileName + ".manifest") && std::filesystem::exists(fileName + ".manifest", error)) {
+			WriteConsole("WARNING: " + fileName + ".manifest can't be read, every file is parsed again");
+		}
+		if (!ParseDBNodeFiles(db)) return false;
+		if (bIncremental) {
+			WriteConsole("Reused " + std::to_string(db.nNumReusedFiles) + " of " + std::to_string(db.aNodeFiles.size()) + " unchanged files");
+		}
+		if (!sCacheFolder.empty()) {
+			WriteConsole("Loaded " + std::to_string(db.nNumCacheHits) + " of " + std::to_string(db.aNodeFiles.size()) + " files from the cache");
+		}
+	}
+	if (!ResolveDBValueNodes(db)) return false;
+
+	WriteConsole("Files read");
+
+	WriteConsole("Creating...");
+	timer.Start("layout");
+
+	for (auto& node : db.aNodes) {
+		std::replace(node.name.begin(), node.name.end(), '(', '[');
+		std::replace(node.name.begin(), node.name.end(), ')', ']');
+		for (auto& value : node.values) {
+			gStats.aNumValuesByType[value.type]++;
+		}
+	}
+	gStats.nNumNodes += db.aNodes.size();
+
+	std::vector<char> file;
+	tDBWriteInfo info;
+	if (!WriteDBTree(db, bInternStrings, file, info)) return ReportError(info.error);
+	if (bInternStrings) {
+		WriteConsole("Interned " + std::to_string(info.numNames) + " names into " + std::to_string(info.numUniqueNames) + " unique strings");
+	}
+
+	timer.Start("write");
+	if (!WriteFileReplacing(fileName, file.data(), file.size())) return false;
+
+	// the db itself is fine without it, the next run just has nothing to reuse
+	if (bIncremental && sSingleFileName.empty() && !SaveDBManifest(db, fileName + ".manifest")) {
+		WriteConsole("WARNING: The manifest wasn't saved, the next --incremental run will parse every file again");
+	}
+
+	WriteConsole("Database created");
+
+	return true;
+}
+
+bool MakeDB(const std::string& fileName, int numJobs) {
+	auto folderName = !sSingleFileName.empty() ? sSingleFileName : fileName + " extracted";
+	std::error_code error;
+	if (!std::filesystem::exists(folderName, error)) {
+		return ReportError("Failed to load " + std::filesystem::absolute(folderName).string() + "! (File doesn't exist)");
+	}
+
+	tDBBuilder db;
+	db.fileName = fileName;
+	db.nNumJobs = numJobs;
+	if (!WriteDB(db)) {
+		return ReportError("Failed to make binary database " + std::filesystem::absolute(fileName).string() + "!");
+	}
+	return true;
+}
+
+// "<node path>.<value> = <new value>" lines change values that already exist and keep their type,
+// "#node <path>" sections take .h lines and "#remove-value <name>" lines like the ones the extractor's diff --patch writes
+bool ReadDBPatchScript(const tDBFile& file, const std::string& script, std::vector<tDBValueEdit>& out) {
+	std::unordered_map<std::string_view, int> nodeIdsByPath;
+	nodeIdsByPath.reserve(file.nNumNodes);
+	for (size_t i = 0; i < file.nNumNodes; i++) {
+		nodeIdsByPath.try_emplace(file.aNodePaths[i], i);
+	}
+	auto findNode = [&](std::string_view path) {
+		auto it = nodeIdsByPath.find(GetDBName(path));
+		return it != nodeIdsByPath.end() ? it->second : -1;
+	};
+
+	// values are read by the same code as the extracted files, into a node that's only used for this
+	tDBBuilder parser;
+	tDBNodeTemp parsed;
+	auto addParsedValue = [&](int nodeId, const std::string& name) {
+		auto& value = parsed.values.back();
+		auto& edit = out.emplace_back();
+		edit.nodeId = nodeId;
+		edit.name = name;
+		edit.type = value.type;
+		edit.arrayCount = value.arrayCount;
+		if (value.type == DBVALUE_NODE) {
+			for (auto path : value.nodePaths) {
+				auto id = findNode(path);
+				if (id < 0) return ReportError("Failed to find node " + (std::string)path);
+				uint16_t ref = id;
+				edit.data.append((const char*)&ref, sizeof(ref));
+			}
+		}
+		else edit.data.assign((const char*)value.data, value.arrayCount * GetDBValueTypeSize(value.type));
+		parsed.values.clear();
+		return true;
+	};
+
+	tLineReader reader = {script};
+	int nodeId = -1;
+	for (std::string_view line; reader.GetLine(line); ) {
+		auto tmp = line;
+		while (tmp.starts_with('\t') || tmp.starts_with(' ')) tmp.remove_prefix(1);
+		if (tmp.empty() || tmp.starts_with("//")) continue;
+
+		if (tmp.starts_with("#node ")) {
+			parsed.name = tmp.substr(6);
+			nodeId = findNode(parsed.name);
+			if (nodeId < 0) return ReportError("Adding nodes needs a full repack, " + parsed.name + " isn't in " + file.fileName);
+			continue;
+		}
+		if (tmp.starts_with("#remove-node ")) {
+			return ReportError("Removing nodes needs a full repack, can't remove " + (std::string)tmp.substr(13));
+		}
+		if (tmp.starts_with("#remove-value ")) {
+			if (nodeId < 0) return ReportError("Found " + (std::string)line + " before the first #node");
+			auto& edit = out.emplace_back();
+			edit.nodeId = nodeId;
+			edit.name = GetDBName(tmp.substr(14));
+			edit.remove = true;
+			continue;
+		}
+
+		bool isDeclaration = false;
+		for (auto typeName : aValueTypeNames) {
+			if (!typeName || !tmp.starts_with(typeName) || tmp.length() <= strlen(typeName)) continue;
+			auto next = tmp[strlen(typeName)];
+			if (next == ' ' || next == '*') isDeclaration = true;
+		}
+		if (isDeclaration) {
+			if (nodeId < 0) return ReportError("Found " + (std::string)line + " before the first #node");
+			if (!ParseDBLine(parser, &parsed, line, reader)) return false;
+			if (!parsed.values.empty() && !addParsedValue(nodeId, GetDBName(parsed.values.back().name))) return false;
+			continue;
+		}
+
+		auto split = tmp.find(" = ");
+		auto dot = split == std::string_view::npos ? split : tmp.substr(0, split).rfind('.');
+		if (dot == std::string_view::npos) return ReportError("Failed to read patch line " + (std::string)line);
+		auto path = tmp.substr(0, dot);
+		auto id = findNode(path);
+		if (id < 0) return ReportError("Adding nodes needs a full repack, " + (std::string)path + " isn't in " + file.fileName);
+		auto name = GetDBName(tmp.substr(dot + 1, split - dot - 1));
+		auto original = FindNodeValue(file, &file.pRootNode[id], name);
+		if (!original) return ReportError((std::string)path + " has no value " + name + ", use a #node section to add one");
+		if (original->valueType >= DBVALUE_MAX_COUNT || !aValueTypeNames[original->valueType]) {
+			return ReportError("Unknown type " + std::to_string(original->valueType) + " for " + name + " in " + (std::string)path);
+		}
+
+		// turned into the .h line the extractor would have written for it, arrays continue on the lines after it
+		bool isArray = original->arrayType == DBARRAY_FIXED && original->valueType != DBVALUE_STRING;
+		std::string declaration = aValueTypeNames[original->valueType];
+		if (original->valueType == DBVALUE_STRING && original->arrayType == DBARRAY_VARIABLE) declaration += '*';
+		declaration += isArray ? " value[] = " : " value = ";
+		declaration += tmp.substr(split + 3);
+		if (!isArray && !declaration.ends_with(';')) declaration += ';';
+		parsed.name = path;
+		if (!ParseDBLine(parser, &parsed, declaration, reader)) return false;
+		if (!addParsedValue(id, name)) return false;
+	}
+	return true;
+}
+
+// patch <filename> <script> [--output <filename>], applies the script straight to the binary db without extracting it
+int PatchDBFile(int argc, char *argv[]) {
+	std::vector<std::string> args;
+	std::string outputFileName;
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--output" && i + 1 < argc) outputFileName = argv[++i];
+		else args.push_back(arg);
+	}
+	if (args.size() != 2) {
+		WriteConsole("Usage: FlatOut2DBMaker_gcp.exe patch <filename> <script> [--output <filename>]");
+		return 1;
+	}
+	auto& fileName = args[0];
+	if (outputFileName.empty()) outputFileName = fileName;
+
+	// patching follows every offset in the file, so it's always verified first
+	tDBFile db;
+	db.fileName = fileName;
+	if (!db.file.Open(fileName.c_str())) {
+		WriteConsole("ERROR: Failed to load " + std::filesystem::absolute(fileName).string() + "!");
+		return 1;
+	}
+	if (!VerifyDB(db.file.data, db.file.size) || !OpenDB(db, db.file.data, db.file.size)) {
+		WriteConsole("ERROR: " + fileName + " is not a valid database");
+		return 1;
+	}
+
+	std::string script;
+	if (!ReadFileToString(args[1], script)) {
+		WriteConsole("ERROR: Failed to load " + std::filesystem::absolute(args[1]).string() + "!");
+		return 1;
+	}
+	std::vector<tDBValueEdit> edits;
+	if (!ReadDBPatchScript(db, script, edits)) return 1;
+
+	std::vector<char> out;
+	tDBPatchInfo info;
+	if (!PatchDB(db, edits, out, info)) {
+		ReportError(info.error);
+		return 1;
+	}
+	if (!VerifyDB(out.data(), out.size())) {
+		WriteConsole("ERROR: The patched database failed to verify, nothing was written");
+		return 1;
+	}
+
+	// unmapped first, windows won't write to a file that's still mapped
+	db.file.Close();
+	if (!info.numRewrittenNodes && outputFileName == fileName) {
+		// nothing moved, so only the changed records are written
+		std::fstream fout(fileName, std::ios::in | std::ios::out | std::ios::binary);
+		if (!fout.is_open()) {
+			WriteConsole("ERROR: Failed to open " + fileName + " for writing");
+			return 1;
+		}
+		for (auto& [position, size] : info.aOverwrites) {
+			fout.seekp(position);
+			fout.write(&out[position], size);
+		}
+		fout.flush();
+		if (!fout) {
+			WriteConsole("ERROR: Failed to write to " + fileName + ", it may be partially patched");
+			return 1;
+		}
+	}
+	else if (!WriteFileReplacing(outputFileName, out.data(), out.size())) {
+		return 1;
+	}
+	WriteConsole("Applied " + std::to_string(edits.size()) + " edits, " + std::to_string(info.aOverwrites.size()) + " values overwritten in place and " + std::to_string(info.numRewrittenNodes) + " nodes rewritten");
+	return 0;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <unordered_map>
+#include "../shared.h"
+
+// everything the maker does apart from reading its command line, also built into the benchmark
+namespace maker {
+
+// what a node file looked like the last time it was parsed, see --incremental
+struct tManifestEntry {
+	uint64_t size = 0;
+	int64_t writeTime = 0;
+	uint64_t hash = 0;
+	std::string_view values; // WriteDBValueRecords output, points into tDBBuilder::sManifestBuffer
+};
+
+struct tDBNodeFile {
+	int nodeId;
+	std::filesystem::path path;
+
+	// manifest entry for this run, only filled in with --incremental
+	std::string manifestPath;
+	tManifestEntry manifestEntry;
+	std::string values;
+};
+
+// everything read for one db while it's being built, nothing in here is shared between dbs
+struct tDBBuilder : tDBTree {
+	std::string fileName;
+	int nNumJobs = 1;
+	std::vector<tDBNodeFile> aNodeFiles; // .h files found while reading the structure, parsed once every node exists
+	bool hasRootNode = false;
+	std::unordered_map<std::string, tManifestEntry> mManifest; // keyed by the path relative to dbBaseFolderPath
+	std::string sManifestBuffer;
+	std::atomic<int> nNumReusedFiles = 0;
+	std::atomic<int> nNumCacheHits = 0;
+};
+
+extern int nNumJobs;
+extern std::string sSingleFileName; // read everything from this file made by the extractor's --single-file instead of a folder
+extern bool bIncremental;
+extern bool bInternStrings; // store each unique node and value name once instead of once per use
+extern std::filesystem::path sCacheFolder; // empty if disabled, see --cache
+extern uint64_t nCacheSizeLimit;
+
+bool ResolveDBValueNodes(tDBBuilder& db);
+bool ReadDBSingleFile(tDBBuilder& db, const std::string& fileName);
+bool MakeDB(const std::string& fileName, int numJobs);
+void TrimCache();
+
+// the patch mode, takes the whole command line
+int PatchDBFile(int argc, char *argv[]);
+
+}
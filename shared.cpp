@@ -0,0 +1,396 @@
+#include "shared.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#undef WriteConsole // ours, not the winapi one
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+std::ostream* pConsoleOut = &std::cout;
+thread_local std::string sConsolePrefix;
+thread_local std::string sLastError;
+thread_local bool bThreadCPUTime = false;
+
+// counted per thread so allocating never touches a shared cache line, added to gStats when a worker thread finishes
+thread_local uint64_t nThreadAllocations = 0;
+
+void FlushThreadAllocations() {
+	gStats.nNumAllocations.fetch_add(nThreadAllocations, std::memory_order_relaxed);
+	nThreadAllocations = 0;
+}
+
+void WriteConsole(const std::string& str) {
+	static std::mutex mutex;
+	std::lock_guard lock(mutex);
+	auto& out = *pConsoleOut;
+	out << sConsolePrefix;
+	out << str;
+	out << "\n";
+	out.flush();
+}
+
+bool ReportError(const std::string& str) {
+	if (sLastError.empty()) sLastError = str;
+	WriteConsole("ERROR: " + str);
+	return false;
+}
+
+uint64_t GetContentHash(const void* data, size_t size) {
+	uint64_t hash = 0xCBF29CE484222325;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= ((const uint8_t*)data)[i];
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
+
+// 8 bytes at a time through the splitmix64 finalizer
+uint64_t GetContentCheckHash(const void* data, size_t size) {
+	auto mix = [](uint64_t value) {
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EB;
+		return value ^ (value >> 31);
+	};
+	auto bytes = (const uint8_t*)data;
+	uint64_t hash = 0x9E3779B97F4A7C15;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = mix(hash ^ word);
+	}
+	uint64_t tail = 0;
+	if (i < size) memcpy(&tail, bytes + i, size - i);
+	return mix(hash ^ tail ^ (size << 56));
+}
+
+// each thread starts on its own contiguous range and steals half of another thread's remaining range once it runs dry
+void ParallelFor(size_t count, int numThreads, const std::function<void(size_t)>& func) {
+	if (numThreads > count) numThreads = count;
+	if (numThreads <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			func(i);
+		}
+		return;
+	}
+
+	struct tWorkRange {
+		std::mutex mutex;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+	std::vector<tWorkRange> ranges(numThreads);
+	for (int i = 0; i < numThreads; i++) {
+		ranges[i].begin = count * i / numThreads;
+		ranges[i].end = count * (i + 1) / numThreads;
+	}
+
+	auto worker = [&](int id) {
+		auto& own = ranges[id];
+		while (true) {
+			size_t index;
+			{
+				std::lock_guard lock(own.mutex);
+				index = own.begin < own.end ? own.begin++ : count;
+			}
+			if (index < count) {
+				func(index);
+				continue;
+			}
+
+			// out of work, take the back half of the first thread that still has some left
+			bool stolen = false;
+			for (int i = 1; i < numThreads && !stolen; i++) {
+				auto& victim = ranges[(id + i) % numThreads];
+				size_t begin, end;
+				{
+					std::lock_guard lock(victim.mutex);
+					if (victim.begin >= victim.end) continue;
+					begin = victim.begin + (victim.end - victim.begin) / 2;
+					end = victim.end;
+					victim.end = begin;
+				}
+				std::lock_guard lock(own.mutex);
+				own.begin = begin;
+				own.end = end;
+				stolen = true;
+			}
+			if (!stolen) return;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numThreads; i++) {
+		threads.emplace_back([&, i]() {
+			worker(i);
+			FlushThreadAllocations();
+		});
+	}
+	worker(0);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+std::string GetDBName(std::string_view name) {
+	std::string out(name);
+	std::replace(out.begin(), out.end(), '(', '[');
+	std::replace(out.begin(), out.end(), ')', ']');
+	return out;
+}
+
+bool MatchFileNamePattern(std::string_view pattern, std::string_view name) {
+	auto isSameChar = [](char a, char b) {
+#ifdef _WIN32
+		return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+#else
+		return a == b;
+#endif
+	};
+
+	// on a mismatch, go back to the last * and let it swallow one more character
+	size_t p = 0, n = 0;
+	size_t starPattern = std::string_view::npos, starName = 0;
+	while (n < name.length()) {
+		if (p < pattern.length() && (pattern[p] == '?' || isSameChar(pattern[p], name[n]))) {
+			p++;
+			n++;
+		}
+		else if (p < pattern.length() && pattern[p] == '*') {
+			starPattern = p++;
+			starName = n;
+		}
+		else if (starPattern != std::string_view::npos) {
+			p = starPattern + 1;
+			n = ++starName;
+		}
+		else return false;
+	}
+	while (p < pattern.length() && pattern[p] == '*') p++;
+	return p == pattern.length();
+}
+
+void ExpandDBFileArgument(const std::string& arg, std::string_view suffix, std::vector<std::string>& out) {
+	if (arg.starts_with('@')) {
+		std::ifstream fin(arg.substr(1));
+		if (!fin.is_open()) {
+			WriteConsole("ERROR: Failed to open file list " + arg.substr(1));
+			return;
+		}
+		for (std::string line; std::getline(fin, line); ) {
+			if (line.ends_with('\r')) line.pop_back();
+			if (line.empty() || line.starts_with("//")) continue;
+			ExpandDBFileArgument(line, suffix, out);
+		}
+		return;
+	}
+
+	std::filesystem::path path = arg;
+	auto pattern = path.filename().string();
+	if (pattern.find_first_of("*?") == std::string::npos) {
+		out.push_back(arg);
+		return;
+	}
+
+	auto folder = path.parent_path();
+	std::vector<std::string> matches;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(folder.empty() ? "." : folder, error)) {
+		auto name = entry.path().filename().string();
+		if (!suffix.empty()) {
+			if (!name.ends_with(suffix)) continue;
+			name.resize(name.length() - suffix.length());
+		}
+		else if (!entry.is_regular_file()) continue;
+		if (MatchFileNamePattern(pattern, name)) matches.push_back((folder / name).string());
+	}
+	if (matches.empty()) WriteConsole("WARNING: Nothing matches " + arg);
+	std::sort(matches.begin(), matches.end());
+	out.insert(out.end(), matches.begin(), matches.end());
+}
+
+bool ProcessDBFiles(const std::vector<std::string>& fileNames, int numJobs, const std::function<bool(const std::string&)>& func) {
+	// anything thrown fails that one db, escaping a worker thread would end the whole run
+	auto run = [&](const std::string& fileName) {
+		try {
+			return func(fileName);
+		}
+		catch (const std::exception& e) {
+			return ReportError((std::string)"Unexpected error: " + e.what());
+		}
+	};
+	if (fileNames.size() == 1) return run(fileNames[0]);
+
+	std::vector<uint8_t> results(fileNames.size());
+	std::vector<std::string> errors(fileNames.size());
+	ParallelFor(fileNames.size(), numJobs, [&](size_t i) {
+		sConsolePrefix = "[" + fileNames[i] + "] ";
+		sLastError.clear();
+		bThreadCPUTime = true;
+		results[i] = run(fileNames[i]);
+		errors[i] = sLastError;
+		bThreadCPUTime = false;
+		sConsolePrefix.clear();
+	});
+
+	size_t numFailed = 0;
+	for (size_t i = 0; i < fileNames.size(); i++) {
+		if (results[i]) {
+			WriteConsole("OK: " + fileNames[i]);
+		}
+		else {
+			WriteConsole("FAILED: " + fileNames[i] + (errors[i].empty() ? "" : " (" + errors[i] + ")"));
+			numFailed++;
+		}
+	}
+	WriteConsole(std::to_string(fileNames.size() - numFailed) + " of " + std::to_string(fileNames.size()) + " databases succeeded");
+	return numFailed == 0;
+}
+
+bool VerifyDB(const char* data, size_t size) {
+	size_t numPrinted = 0;
+	auto numProblems = VerifyDBData(data, size, [&](const std::string& str) {
+		if (numPrinted++ < nMaxVerifyProblems) ReportError(str);
+	});
+	if (numProblems > nMaxVerifyProblems) WriteConsole("... and " + std::to_string(numProblems - nMaxVerifyProblems) + " more problems");
+	return numProblems == 0;
+}
+
+tStats gStats;
+eStatsFormat nStatsFormat = STATS_NONE;
+
+// every allocation in the program goes through here so --stats can count them
+// all kept out of line, gcc warns about free() on memory from new once it inlines both into the same function
+__attribute__((noinline)) void* operator new(size_t size) {
+	nThreadAllocations++;
+	if (auto ptr = malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+__attribute__((noinline)) void* operator new[](size_t size) {
+	return operator new(size);
+}
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept {
+	free(ptr);
+}
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+	free(ptr);
+}
+__attribute__((noinline)) void operator delete[](void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+double GetProcessCPUTimeMs() {
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) return 0;
+	auto toMs = [](const FILETIME& time) {
+		return ((uint64_t)time.dwHighDateTime << 32 | time.dwLowDateTime) / 10000.0;
+	};
+	return toMs(kernelTime) + toMs(userTime);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	auto toMs = [](const timeval& time) {
+		return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+	};
+	return toMs(usage.ru_utime) + toMs(usage.ru_stime);
+#endif
+}
+
+double GetThreadCPUTimeMs() {
+#ifdef _WIN32
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) return 0;
+	auto toMs = [](const FILETIME& time) {
+		return ((uint64_t)time.dwHighDateTime << 32 | time.dwLowDateTime) / 10000.0;
+	};
+	return toMs(kernelTime) + toMs(userTime);
+#else
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) return 0;
+	return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#endif
+}
+
+uint64_t GetPeakMemoryUsage() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+void WriteStats() {
+	FlushThreadAllocations();
+	auto getTypeName = [](int type) {
+		return type == DBVALUE_STRING ? "string" : aValueTypeNames[type];
+	};
+	char number[64];
+	auto formatMs = [&](double ms) {
+		snprintf(number, sizeof(number), "%.3f", ms);
+		return (std::string)number;
+	};
+
+	uint64_t numValues = 0;
+	for (auto& count : gStats.aNumValuesByType) {
+		numValues += count;
+	}
+
+	std::string out;
+	if (nStatsFormat == STATS_JSON) {
+		out += "{\"phases\":[";
+		for (auto& phase : gStats.aPhases) {
+			if (&phase != &gStats.aPhases[0]) out += ',';
+			out += "{\"name\":\"" + phase.name + "\",\"wallMs\":" + formatMs(phase.wallMs) + ",\"cpuMs\":" + formatMs(phase.cpuMs) + "}";
+		}
+		out += "],\"nodes\":" + std::to_string(gStats.nNumNodes);
+		out += ",\"values\":" + std::to_string(numValues) + ",\"valuesByType\":{";
+		bool isFirst = true;
+		for (int i = 0; i < DBVALUE_MAX_COUNT; i++) {
+			if (!aValueTypeNames[i]) continue;
+			if (!isFirst) out += ',';
+			out += (std::string)"\"" + getTypeName(i) + "\":" + std::to_string(gStats.aNumValuesByType[i]);
+			isFirst = false;
+		}
+		out += "},\"bytesRead\":" + std::to_string(gStats.nNumBytesRead);
+		out += ",\"bytesWritten\":" + std::to_string(gStats.nNumBytesWritten);
+		out += ",\"filesCreated\":" + std::to_string(gStats.nNumFilesCreated);
+		out += ",\"directoriesCreated\":" + std::to_string(gStats.nNumDirectoriesCreated);
+		out += ",\"allocations\":" + std::to_string(gStats.nNumAllocations);
+		out += ",\"peakMemoryBytes\":" + std::to_string(GetPeakMemoryUsage()) + "}";
+	}
+	else {
+		out += "Stats:\n";
+		for (auto& phase : gStats.aPhases) {
+			out += "  " + phase.name + ": " + formatMs(phase.wallMs) + " ms wall, " + formatMs(phase.cpuMs) + " ms cpu\n";
+		}
+		out += "  nodes: " + std::to_string(gStats.nNumNodes) + "\n";
+		out += "  values: " + std::to_string(numValues);
+		bool isFirst = true;
+		for (int i = 0; i < DBVALUE_MAX_COUNT; i++) {
+			if (!aValueTypeNames[i] || !gStats.aNumValuesByType[i]) continue;
+			out += (isFirst ? " (" : ", ") + (std::string)getTypeName(i) + " " + std::to_string(gStats.aNumValuesByType[i]);
+			isFirst = false;
+		}
+		if (!isFirst) out += ")";
+		out += "\n  bytes read: " + std::to_string(gStats.nNumBytesRead) + ", written: " + std::to_string(gStats.nNumBytesWritten) + "\n";
+		out += "  files created: " + std::to_string(gStats.nNumFilesCreated) + ", directories created: " + std::to_string(gStats.nNumDirectoriesCreated) + "\n";
+		out += "  allocations: " + std::to_string(gStats.nNumAllocations) + "\n";
+		out += "  peak memory: " + std::to_string(GetPeakMemoryUsage() / 1024) + " KB";
+	}
+	WriteConsole(out);
+}
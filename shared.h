@@ -1,81 +1,140 @@
+#pragma once
+
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <cstdint>
 #include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <string_view>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <cstdlib>
+
+#include "FlatOut2DB/FlatOut2DB.h"
+
+// console output, errors, threading and --stats for both tools, defined in shared.cpp
+
+extern std::ostream* pConsoleOut; // moved to stderr when stdout is used for data
+extern thread_local std::string sConsolePrefix; // name of the db this thread is working on when several are processed at once
+extern thread_local std::string sLastError; // first error reported for that db, shown again in the summary
+extern thread_local bool bThreadCPUTime; // set while this thread runs one of several dbs at once, see tStatsPhaseTimer
+
+void WriteConsole(const std::string& str);
+// always returns false, so failures can be passed straight up
+bool ReportError(const std::string& str);
+
+// FNV-1a, used to tell whether file contents changed between runs
+uint64_t GetContentHash(const void* data, size_t size);
+// unrelated to GetContentHash, stored next to it where a collision would silently give the wrong contents
+uint64_t GetContentCheckHash(const void* data, size_t size);
+
+// runs func(i) for every i in [0, count) on up to numThreads threads
+void ParallelFor(size_t count, int numThreads, const std::function<void(size_t)>& func);
+
+// * matches any number of characters and ? matches one, case insensitive on windows like the filesystem
+bool MatchFileNamePattern(std::string_view pattern, std::string_view name);
+
+// the extractor writes '[' and ']' in names as '(' and ')', this turns a path or value name spelled that way back into the db's
+std::string GetDBName(std::string_view name);
+
+// adds the dbs named by one command line argument to out
+// a pattern in the last part of the path is matched against that folder, @file reads one argument per line from file
+// with a suffix only entries ending in it are matched and it's cut off, the maker uses this to find "<db> extracted" folders
+void ExpandDBFileArgument(const std::string& arg, std::string_view suffix, std::vector<std::string>& out);
+
+// runs func on every db, up to numJobs of them at once, then prints which ones failed and why
+// a single db is just run as it is, without the summary, anything it throws only fails that one db
+bool ProcessDBFiles(const std::vector<std::string>& fileNames, int numJobs, const std::function<bool(const std::string&)>& func);
+
+const size_t nMaxVerifyProblems = 20; // only this many are printed, the rest are just counted
+
+// prints the first few problems VerifyDBData finds as errors, and how many more there were
+bool VerifyDB(const char* data, size_t size);
 
-void WriteConsole(const std::string& str) {
-	static auto& out = std::cout;
-	out << str;
-	out << "\n";
-	out.flush();
-}
-
-enum eDBValueType {
-	DBVALUE_CHAR = 1,
-	DBVALUE_STRING = 2,
-	DBVALUE_BOOL = 5,
-	DBVALUE_INT = 6,
-	DBVALUE_FLOAT = 7,
-	DBVALUE_RGBA = 8,
-	DBVALUE_VECTOR2 = 9,
-	DBVALUE_VECTOR3 = 10,
-	DBVALUE_VECTOR4 = 11,
-	DBVALUE_NODE = 12,
-	DBVALUE_MAX_COUNT
+// everything --stats reports, counted for the whole run no matter how many dbs it went through
+struct tStats {
+	struct tPhase {
+		std::string name;
+		double wallMs = 0;
+		double cpuMs = 0;
+	};
+	std::mutex mutex;
+	std::vector<tPhase> aPhases; // same named phases from different dbs are added together
+
+	std::atomic<uint64_t> nNumNodes = 0;
+	std::atomic<uint64_t> aNumValuesByType[DBVALUE_MAX_COUNT] = {};
+	std::atomic<uint64_t> nNumBytesRead = 0;
+	std::atomic<uint64_t> nNumBytesWritten = 0;
+	std::atomic<uint64_t> nNumFilesCreated = 0;
+	std::atomic<uint64_t> nNumDirectoriesCreated = 0;
+	std::atomic<uint64_t> nNumAllocations = 0;
+
+	void AddPhase(const std::string& name, double wallMs, double cpuMs) {
+		std::lock_guard lock(mutex);
+		for (auto& phase : aPhases) {
+			if (phase.name != name) continue;
+			phase.wallMs += wallMs;
+			phase.cpuMs += cpuMs;
+			return;
+		}
+		aPhases.push_back({name, wallMs, cpuMs});
+	}
+
+	void AddFileWritten(size_t size) {
+		nNumBytesWritten += size;
+		nNumFilesCreated++;
+	}
 };
-const char* aValueTypeNames[] = {
-		nullptr,
-		"char",
-		"const char",
-		nullptr,
-		nullptr,
-		"bool",
-		"int",
-		"float",
-		"rgba",
-		"vec2",
-		"vec3",
-		"vec4",
-		"node*",
+extern tStats gStats;
+
+enum eStatsFormat {
+	STATS_NONE,
+	STATS_TEXT,
+	STATS_JSON,
 };
+extern eStatsFormat nStatsFormat;
 
-bool IsDBTypeVector(int type) {
-	return type >= DBVALUE_VECTOR2 && type <= DBVALUE_VECTOR4;
-}
-
-size_t GetDBValueTypeSize(int type) {
-	switch (type) {
-		case DBVALUE_CHAR:
-		case DBVALUE_STRING:
-			return 1;
-		case DBVALUE_NODE:
-			return 2;
-		case DBVALUE_BOOL:
-		case DBVALUE_RGBA:
-		case DBVALUE_INT:
-		case DBVALUE_FLOAT:
-			return 4;
-		case DBVALUE_VECTOR2:
-			return 4 * 2;
-		case DBVALUE_VECTOR3:
-			return 4 * 3;
-		case DBVALUE_VECTOR4:
-			return 4 * 4;
-		default:
-			return 0;
+// user and kernel time of every thread in the process, or only the calling one
+double GetProcessCPUTimeMs();
+double GetThreadCPUTimeMs();
+uint64_t GetPeakMemoryUsage();
+
+// times one phase after another, Start ends the current phase and Stop or going out of scope ends the last one
+// with several dbs at once each one runs on its own thread, so only that thread's cpu time counts towards its phases,
+// otherwise the phase may spread over worker threads and the whole process is counted
+struct tStatsPhaseTimer {
+	std::string name;
+	std::chrono::steady_clock::time_point wallStart;
+	double cpuStart = 0;
+	bool isThreadCPUTime = false;
+
+	double GetCPUTimeMs() const {
+		return isThreadCPUTime ? GetThreadCPUTimeMs() : GetProcessCPUTimeMs();
+	}
+
+	~tStatsPhaseTimer() { Stop(); }
+
+	void Start(const std::string& phaseName) {
+		Stop();
+		name = phaseName;
+		wallStart = std::chrono::steady_clock::now();
+		isThreadCPUTime = bThreadCPUTime;
+		cpuStart = GetCPUTimeMs();
 	}
-}
 
-enum eDBArrayType {
-	DBARRAY_SINGLE,
-	DBARRAY_FIXED,
-	DBARRAY_VARIABLE, // used for strings
+	void Stop() {
+		if (name.empty()) return;
+		auto wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+		gStats.AddPhase(name, wallMs, GetCPUTimeMs() - cpuStart);
+		name.clear();
+	}
 };
 
-struct tDBHeader {
-	uint32_t identifier;
-	uint32_t version;
-	uint32_t numNodes;
-};
\ No newline at end of file
+void WriteStats();